@@ -100,10 +100,14 @@ int main(){
   GfragShader.addOutput(sga::DataType::Float3, "out_albedo");
   auto program_gbuffer = sga::Program::createAndCompile(GvertShader, GfragShader);
 
-  // Create buffers
-  sga::Image buffer_position(window.getWidth(),window.getHeight(), 3, sga::ImageFormat::Float);
-  sga::Image buffer_normal(window.getWidth(),window.getHeight(), 3, sga::ImageFormat::Float);
-  sga::Image buffer_albedo(window.getWidth(),window.getHeight(), 3, sga::ImageFormat::Float);
+  // Create buffers. They are read by the lighting pass as input attachments.
+  auto createGBuffer = [](unsigned int w, unsigned int h){
+    return sga::Image(w,h, 3, sga::ImageFormat::Float, sga::ImageFilterMode::None,
+                      sga::ImageUsage::InputAttachment);
+  };
+  sga::Image buffer_position = createGBuffer(window.getWidth(),window.getHeight());
+  sga::Image buffer_normal = createGBuffer(window.getWidth(),window.getHeight());
+  sga::Image buffer_albedo = createGBuffer(window.getWidth(),window.getHeight());
   
   // G-buffer pipeline
   sga::Pipeline pipeline_gbuffer;
@@ -112,13 +116,12 @@ int main(){
   pipeline_gbuffer.setFaceCull(sga::FaceCullMode::Back);
   pipeline_gbuffer.setTarget({buffer_position, buffer_normal, buffer_albedo});
 
-  // Lighting program
+  // Lighting program, which reads the G-buffer as input attachments.
   auto LfragShader = sga::FragmentShader::createFromSource(R"(
     void main(){
-      vec2 here = sgaWindowCoords;
-      vec3 position = texture(buffer_position, here).xyz;
-      vec3 normal   = normalize(texture(buffer_normal,   here).xyz);
-      vec3 albedo   = texture(buffer_albedo,   here).xyz;
+      vec3 position = subpassLoad(buffer_position).xyz;
+      vec3 normal   = normalize(subpassLoad(buffer_normal).xyz);
+      vec3 albedo   = subpassLoad(buffer_albedo).xyz;
 
       vec3 L = normalize(lightpos - position);
       vec3 R = -reflect(L, normal);
@@ -131,9 +134,9 @@ int main(){
       out_color = vec4((a + d + s) * 0.86, 1.0);
     })");
   LfragShader.addOutput(sga::DataType::Float4, "out_color");
-  LfragShader.addSampler("buffer_position");
-  LfragShader.addSampler("buffer_normal");
-  LfragShader.addSampler("buffer_albedo");
+  LfragShader.addInputAttachment("buffer_position");
+  LfragShader.addInputAttachment("buffer_normal");
+  LfragShader.addInputAttachment("buffer_albedo");
   LfragShader.addUniform(sga::DataType::Float3, "viewpos");
   LfragShader.addUniform(sga::DataType::Float3, "lightpos");
   auto program_lighting = sga::Program::createAndCompile(LfragShader);
@@ -144,11 +147,17 @@ int main(){
   // Lighting pipeline
   sga::FullQuadPipeline pipeline_lighting;
   pipeline_lighting.setProgram(program_lighting);
-  pipeline_lighting.setSampler("buffer_position", buffer_position);
-  pipeline_lighting.setSampler("buffer_normal", buffer_normal);
-  pipeline_lighting.setSampler("buffer_albedo", buffer_albedo);
+  pipeline_lighting.setInputAttachment("buffer_position", buffer_position);
+  pipeline_lighting.setInputAttachment("buffer_normal", buffer_normal);
+  pipeline_lighting.setInputAttachment("buffer_albedo", buffer_albedo);
   pipeline_lighting.setTarget(result_image);
 
+  // Both passes are subpasses of a single render pass, so the G-buffer is
+  // read where it was written, without any layout transitions in between.
+  sga::PipelineChain chain;
+  chain.addPipeline(pipeline_gbuffer);
+  chain.addPipeline(pipeline_lighting);
+
   // Window program
   auto WfragShader = sga::FragmentShader::createFromSource(R"(
     void main(){
@@ -203,15 +212,15 @@ int main(){
 
   window.setOnResize([&](unsigned int w, unsigned int h){
       // Recreate internediate and target images.
-      buffer_position = sga::Image(w,h, 3, sga::ImageFormat::Float);
-      buffer_normal   = sga::Image(w,h, 3, sga::ImageFormat::Float);
-      buffer_albedo   = sga::Image(w,h, 3, sga::ImageFormat::Float);
+      buffer_position = createGBuffer(w,h);
+      buffer_normal   = createGBuffer(w,h);
+      buffer_albedo   = createGBuffer(w,h);
       result_image = sga::Image(w,h);
       // Reset samplers and render targets
       pipeline_gbuffer.setTarget({buffer_position, buffer_normal, buffer_albedo});
-      pipeline_lighting.setSampler("buffer_position", buffer_position);
-      pipeline_lighting.setSampler("buffer_normal", buffer_normal);
-      pipeline_lighting.setSampler("buffer_albedo", buffer_albedo);
+      pipeline_lighting.setInputAttachment("buffer_position", buffer_position);
+      pipeline_lighting.setInputAttachment("buffer_normal", buffer_normal);
+      pipeline_lighting.setInputAttachment("buffer_albedo", buffer_albedo);
       pipeline_lighting.setTarget(result_image);
       pipeline_window.setSampler("buffer_position", buffer_position);
       pipeline_window.setSampler("buffer_normal", buffer_normal);
@@ -247,10 +256,12 @@ int main(){
     pipeline_lighting.setUniform("lightpos", lightpos);
     pipeline_lighting.setUniform("viewpos", viewpos);
 
+    chain.begin();
     pipeline_gbuffer.clear();
     pipeline_gbuffer.draw(modelVbo);
     pipeline_lighting.clear();
     pipeline_lighting.drawFullQuad();
+    chain.end();
     pipeline_window.clear();
     pipeline_window.drawFullQuad();
 
@@ -47,7 +47,7 @@ int main(int argc, char** argv){
   glm::vec3 lightlookat = {0, 0, 0};
   float lightnear = -8.0f, lightfar = 8.0f;
   float shadowmap_size = 4096, shadowmap_range = 6.0f;
-  sga::Image shadowmap(shadowmap_size, shadowmap_size, 1, sga::ImageFormat::Float, sga::ImageFilterMode::None);
+  sga::Image shadowmap(shadowmap_size, shadowmap_size, 1, sga::ImageFormat::Depth, sga::ImageFilterMode::None);
   glm::mat4 shadowmapProj = glm::ortho(-shadowmap_range, shadowmap_range, -shadowmap_range, shadowmap_range, lightnear, lightfar);
 
   // Prepare window
@@ -81,16 +81,15 @@ int main(int argc, char** argv){
   fragShader.addUniform(sga::DataType::SInt, "use_texture");
   fragShader.addUniform(sga::DataType::SInt, "debug");
   fragShader.addSampler("diffuse");
-  fragShader.addSampler("shadowmap");
+  fragShader.addShadowSampler("shadowmap");
 
   auto shadowmapFragShader = sga::FragmentShader::createFromFile(EXAMPLE_DATA_DIR "/shadowmap/shadow.frag");
   shadowmapFragShader.addInput(sga::DataType::Float3, "in_world_position");
   shadowmapFragShader.addInput(sga::DataType::Float3, "in_world_normal");
   shadowmapFragShader.addInput(sga::DataType::Float2, "in_texuv");
   shadowmapFragShader.addInput(sga::DataType::Float3, "in_shadowmap");
-  shadowmapFragShader.addOutput(sga::DataType::Float, "out_depth");
 
-  // Shadowmap render pass
+  // Shadowmap render pass, which renders depth only
   sga::Program shadowmapProgram = sga::Program::createAndCompile(mainVertShader, shadowmapFragShader);
   sga::Pipeline shadowmapPipeline;
   shadowmapPipeline.setProgram(shadowmapProgram);
@@ -108,12 +107,12 @@ int main(int argc, char** argv){
   sga::Image no_image = sga::Image(16, 16);
   pipeline.setSampler("diffuse", no_image);
   pipeline.setUniform("color_diffuse", glm::vec3{0.0f, 0.0f, 0.0f});
-  pipeline.setSampler("shadowmap", shadowmap);
+  pipeline.setSampler("shadowmap", shadowmap, sga::SamplerInterpolation::Linear);
   pipeline.setUniform("debug", 0);
 
   // Shadowmap preview render pass
   sga::FullQuadPipeline previewPipeline;
-  auto previewShader = sga::FragmentShader::createFromFile(EXAMPLE_DATA_DIR "/sponza-shadowmap/preview.frag");
+  auto previewShader = sga::FragmentShader::createFromFile(EXAMPLE_DATA_DIR "/shadowmap/preview.frag");
   previewShader.addSampler("shadowmap");
   previewShader.addOutput(sga::DataType::Float4,"out_color");
   previewPipeline.setProgram(sga::Program::createAndCompile(previewShader));
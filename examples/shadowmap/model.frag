@@ -6,16 +6,15 @@ float attenuation(float r, float f, float d) {
 }
 
 float get_shadow(vec2 coords, vec2 offset){
-  float sm = texture(shadowmap, (coords/2.0 + 0.5) + offset).x;
-  if(sm < 1.0 - in_shadowmap.z + 0.001) return 1.0;
-  else return 0.0;
+  // The comparison is performed by the sampler.
+  return texture(shadowmap, vec3((coords/2.0 + 0.5) + offset, in_shadowmap.z - 0.001));
 }
 
-// PCF
+// PCF, each sample is already filtered from 2x2 comparisons by the hardware.
 float get_shadow_filtered(vec2 c){
   float d = 1.0/textureSize(shadowmap, 0).x;
   float acc = 0;
-  int count = 0, range = 3;
+  int count = 0, range = 1;
   for(int dx = -range; dx <= range; dx++)
     for(int dy = -range; dy <= range; dy++){
       acc += get_shadow(c, vec2(d*dx, d*dy));
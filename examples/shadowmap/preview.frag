@@ -1,4 +1,4 @@
 void main(){
-  float d = texture(shadowmap, sgaViewportCoords).x;
+  float d = 1.0 - texture(shadowmap, sgaViewportCoords).x;
   out_color = vec4(d,d,d,1);
 }
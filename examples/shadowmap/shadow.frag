@@ -1,3 +1,3 @@
 void main(){
-  out_depth = 1.0 - gl_FragCoord.z;
+  // Only depth is written.
 }
@@ -8,6 +8,13 @@
 #include <sga/pipeline.hpp>
 #include <sga/vbo.hpp>
 #include <sga/shader.hpp>
+#include <sga/query.hpp>
+#include <sga/pingpong.hpp>
+#include <sga/compute.hpp>
+#include <sga/bundle.hpp>
+#include <sga/chain.hpp>
+#include <sga/frame.hpp>
+#include <sga/statistics.hpp>
 
 
 #endif // __SGA_HPP__
@@ -0,0 +1,54 @@
+#ifndef __SGA_BUNDLE_HPP__
+#define __SGA_BUNDLE_HPP__
+
+#include "config.hpp"
+
+namespace sga{
+
+class Pipeline;
+class FullQuadPipeline;
+class VBO;
+class IBO;
+
+/** A sequence of draws which is recorded once and then replayed any number of
+    times, e.g. once per frame. Replaying executes previously recorded
+    commands as they are, so it skips nearly all of the CPU work performed by
+    Pipeline::draw, which makes it a good fit for static scenes.
+
+    Each recorded draw keeps the pipeline state, uniform values and sampler
+    bindings that were in effect when it was recorded. Values which change
+    between replays should be kept in frame uniforms (see FrameUniforms),
+    which are read at the time of replay, just like `sgaTime`. Images bound to
+    samplers are sampled with their contents at the time of replay.
+
+    Draws are replayed onto the current targets of the pipelines that recorded
+    them. A bundle must be recorded again if these targets are changed or
+    resized. Draws using occlusion queries or draw conditions cannot be
+    recorded. */
+class Bundle{
+public:
+  SGA_API Bundle();
+  SGA_API ~Bundle();
+
+  /** Records a draw of a VBO with the current configuration of a pipeline,
+      see Pipeline::draw. */
+  SGA_API void draw(Pipeline& pipeline, const VBO& vbo);
+  /** Records an indexed draw, see Pipeline::drawIndexed. */
+  SGA_API void drawIndexed(Pipeline& pipeline, const VBO& vbo, const IBO& ibo);
+  /** Records a full quad draw, see FullQuadPipeline::drawFullQuad. */
+  SGA_API void drawFullQuad(FullQuadPipeline& pipeline);
+
+  /** Performs all recorded draws, in the order they were recorded. */
+  SGA_API void replay();
+  /** Removes all recorded draws. */
+  SGA_API void reset();
+
+  friend class Pipeline;
+private:
+  class Impl;
+  pimpl_unique_ptr<Impl> impl;
+};
+
+} // namespace sga
+
+#endif // __SGA_BUNDLE_HPP__
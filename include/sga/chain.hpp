@@ -0,0 +1,55 @@
+#ifndef __SGA_CHAIN_HPP__
+#define __SGA_CHAIN_HPP__
+
+#include "config.hpp"
+
+namespace sga{
+
+class Pipeline;
+
+/** Renders with several pipelines within a single render pass, in which each
+    pipeline draws in its own subpass. Later pipelines may read the results of
+    earlier ones at the pixel they shade as input attachments (see
+    FragmentShader::addInputAttachment and Pipeline::setInputAttachment),
+    e.g. a lighting pass may read the G-buffer of deferred shading. On tiled
+    GPUs such intermediate results may then never leave on-chip memory, and
+    targets need no layout transitions between the pipelines.
+
+    Pipelines are added once, in the order in which they render. Draws are
+    then made between begin() and end(), as usual, with each pipeline drawing
+    only after all pipelines added before it. The draws are performed by a
+    single render pass recorded by end(). Targets cleared while the chain
+    records (see Pipeline::clear) are cleared at the beginning of that render
+    pass, before any of its draws.
+
+    All pipelines of a chain must render onto single-layer images of
+    identical size, and cannot use multisampling. Draws within a chain see
+    values of frame uniforms (see FrameUniforms) from the time of end().
+    Images written by a chain cannot be sampled by its pipelines, and writes
+    to storage buffers made by one pipeline are not visible to later
+    pipelines of the chain. */
+class PipelineChain{
+public:
+  SGA_API PipelineChain();
+  SGA_API ~PipelineChain();
+
+  /** Appends a pipeline to the chain. It will render after all pipelines
+      added before it. A pipeline may belong to a single chain only. It can
+      still be used on its own when the chain does not record. */
+  SGA_API void addPipeline(Pipeline& pipeline);
+
+  /** Starts recording draws of pipelines of this chain. */
+  SGA_API void begin();
+  /** Performs all draws made since begin(). */
+  SGA_API void end();
+
+private:
+  class Impl;
+  pimpl_unique_ptr<Impl> impl;
+
+  friend class Pipeline;
+};
+
+} // namespace sga
+
+#endif // __SGA_CHAIN_HPP__
@@ -0,0 +1,64 @@
+#ifndef __SGA_COMPUTE_HPP__
+#define __SGA_COMPUTE_HPP__
+
+#include "config.hpp"
+#include "pipeline.hpp"
+
+namespace sga{
+
+/** Runs compute programs (see ComputeShader). A compute pipeline binds
+    uniforms, samplers and storage images to its program in the same way a
+    Pipeline does, and keeps them separately for each program it was used
+    with. It has no targets, results are written to storage images or
+    storage buffers instead.
+
+    Dispatches are recorded together with draws, in order, and do not wait
+    for the device. Images written by a dispatch may be sampled or rendered
+    onto by subsequent draws and dispatches right away. */
+class ComputePipeline{
+public:
+  SGA_API ComputePipeline();
+  SGA_API ~ComputePipeline();
+
+  /** Sets the program to run. It must be a compiled compute program. */
+  SGA_API void setProgram(const Program&);
+
+  SGA_API void setSampler(std::string, const Image&,
+                          SamplerInterpolation interpolation = SamplerInterpolation::Linear,
+                          SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+  SGA_API void setSampler(std::string, unsigned int index, const Image&,
+                          SamplerInterpolation interpolation = SamplerInterpolation::Linear,
+                          SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+  /** Binds an image to a storage image of the program (see
+      ComputeShader::addStorageImage). The image must have been created with
+      ImageUsage::Storage, have the number of channels and the format the
+      storage image was declared with, and it cannot have mipmaps. */
+  SGA_API void setStorageImage(std::string, const Image&);
+  /** Binds a buffer to a storage buffer of the program (see
+      Shader::addStorageBuffer). */
+  SGA_API void setStorageBuffer(std::string, const StorageBuffer&);
+
+  /** Runs the program over a grid of x * y * z work groups. Each work group
+      consists of the number of invocations set with
+      ComputeShader::setWorkGroupSize. */
+  SGA_API void dispatch(unsigned int x, unsigned int y = 1, unsigned int z = 1);
+
+  //@{
+  /** Sets the value of a named uniform of the program (see
+      Pipeline::setUniform). */
+  #define SGA_UNIFORM_KEY const std::string&
+  #include "pipeline.uniforms.inc"
+  #undef SGA_UNIFORM_KEY
+  SGA_API void setUniform(const std::string& name, std::initializer_list<float> floats);
+  //@}
+
+private:
+  SGA_API void setUniform(DataType dt, const std::string& name, char* pData, size_t size);
+
+  class Impl;
+  pimpl_unique_ptr<Impl> impl;
+};
+
+} // namespace sga
+
+#endif // __SGA_COMPUTE_HPP__
@@ -0,0 +1,45 @@
+#ifndef __SGA_FRAME_HPP__
+#define __SGA_FRAME_HPP__
+
+#include <string>
+#include <array>
+#include <initializer_list>
+
+#include "config.hpp"
+#include "layout.hpp"
+
+namespace sga{
+
+/** Uniforms shared by all programs and pipelines, which keep the same value
+    for everything drawn within a frame, e.g. camera matrices. They live in a
+    single buffer which is bound once for all draws, and which is uploaded at
+    most once per frame, unless a value is changed in the middle of a frame.
+    The standard uniform `sgaTime` is kept there as well.
+
+    Frame uniforms are available in all shaders under their names, just like
+    uniforms declared with Shader::addUniform. They must all be declared
+    before the first program is compiled.
+
+    FrameUniforms carries no state, all its instances refer to the same global
+    set of frame uniforms. */
+class FrameUniforms{
+public:
+  /** Declares a new frame uniform. */
+  SGA_API void addUniform(DataType type, std::string name);
+
+  //@{
+  /** Sets the value of a frame uniform. The new value is used by all
+      subsequent draws. */
+  #define SGA_UNIFORM_KEY const std::string&
+  #include "pipeline.uniforms.inc"
+  #undef SGA_UNIFORM_KEY
+  SGA_API void setUniform(const std::string& name, std::initializer_list<float> floats);
+  //@}
+
+private:
+  SGA_API void setUniform(DataType dt, const std::string& name, char* pData, size_t size);
+};
+
+} // namespace sga
+
+#endif // __SGA_FRAME_HPP__
@@ -23,6 +23,23 @@ enum class ImageFormat{
   SInt32, /// Signed 32-bit integers [-2147483648..2147483647]
   UInt32, /// Unsigned 32-bit ingegers [0..4294967296]
   Float,  /// Signed 32-bit IEEE floating point numbers
+  Depth,  /// 32-bit floating point depth values. Images of this format must
+          /// have a single channel. They can be used as depth targets (see
+          /// Pipeline::setTarget) and sampled with regular or shadow samplers
+          /// (see Shader::addShadowSampler).
+  Depth16, /// 16-bit depth values normalized to [0..1] range, used like Depth.
+           /// These are floats in shaders, but unsigned integers [0..65535] in
+           /// application. Half the memory and bandwidth of Depth, which is
+           /// often enough for shadow maps.
+};
+
+/** @brief The format of a depth buffer that is not an sga::Image.
+ * Used for depth buffers of windows and internal depth buffers of pipelines.
+ * Not all devices support D24S8. */
+enum class DepthFormat{
+  D16,   /// 16-bit normalized depth.
+  D24S8, /// 24-bit normalized depth with 8 unused stencil bits.
+  D32,   /// 32-bit floating point depth. Use this format for reverse-Z.
 };
 
 class Utils;
@@ -32,6 +49,7 @@ struct ImageClearColor{
   static ImageClearColor NInt8(int r, int g){ return ImageClearColor(ImageFormat::NInt8, 2).setUInt32(r,g,0,255); }
   static ImageClearColor NInt8(int r, int g, int b){ return ImageClearColor(ImageFormat::NInt8, 3).setUInt32(r,g,b,255); }
   static ImageClearColor NInt8(int r, int g, int b, int a){ return ImageClearColor(ImageFormat::NInt8, 4).setUInt32(r,g,b,a); }
+  static ImageClearColor Depth(float depth){ ImageClearColor c(ImageFormat::Depth, 1); c.float32[0] = depth; return c; }
 
   ImageClearColor(ImageFormat f, unsigned int c) : format(f), components(c), uint32{0,0,0,0} {}
   friend class Utils;
@@ -57,6 +75,39 @@ enum class ImageFilterMode{
   Anisotropic
 };
 
+/** @brief Optional uses of an sga::Image.
+ * Images can always be sampled, rendered onto and transferred to and from.
+ * Other uses must be requested when an image is created, as supporting them
+ * may slow down its regular use, e.g. by disabling framebuffer compression.
+ * Flags may be combined with `|`. */
+enum class ImageUsage : unsigned int{
+  Default = 0,
+  Storage = 1, /// The image can be bound to storage images (see
+               /// ComputePipeline::setStorageImage). The format must support
+               /// storage on this device.
+  InputAttachment = 2, /// The image can be bound to input attachments (see
+                       /// Pipeline::setInputAttachment). Not available for
+                       /// depth images.
+};
+inline ImageUsage operator|(ImageUsage a, ImageUsage b){
+  return ImageUsage(static_cast<unsigned int>(a) | static_cast<unsigned int>(b));
+}
+inline bool operator&(ImageUsage a, ImageUsage b){
+  return (static_cast<unsigned int>(a) & static_cast<unsigned int>(b)) != 0;
+}
+
+/** @brief The arrangement of layers of an sga::Image.
+ * Samplers declare which of these they read (see Shader::addSampler), and must
+ * be bound to images of the same type. */
+enum class ImageType{
+  Single, /// A single 2D image, sampled with `sampler2D`.
+  Array,  /// A number of 2D layers of the same size, sampled with
+          /// `sampler2DArray` at `vec3(coords, layer)`.
+  Cube,   /// Six square layers, which are the faces of a cube in the order +X,
+          /// -X, +Y, -Y, +Z, -Z. Sampled with `samplerCube` in the direction
+          /// of a `vec3`, e.g. for environment maps.
+};
+
 /** An sga::Image represents an area of video memory that is interpreted as an
  * image. It is commonly used for providing textures to samplers, and as a
  * source for renred pipelines. Images may be loaded from and saved to files.
@@ -64,6 +115,11 @@ enum class ImageFilterMode{
  * Images also have a constant number of channels and format, which describes
  * contents type (see ImageFrormat).
  *
+ * Array and cube images (see ImageType) consist of several layers. Their
+ * data, as passed to putData and getData, holds all layers one after another.
+ * Pipelines may render onto a single layer, or onto all of them at once (see
+ * Pipeline::setTargetLayer).
+ *
  * Image is a reference type, so any copies of an instance refer to the same
  * underlying object.*/
 class Image{
@@ -78,16 +134,34 @@ public:
    * per component) and will be interpreted as an unsigned integer. For details,
    * see sga::ImageFormat.
    * @param filtermode If you want the image to use mipmaps or anisotropic
-   * filterning, the mipmaps will be automatically generated after each image
-   * modification if you enable mipmaps or anisotropic filtering with this
-   * option. */
+   * filterning, the mipmaps will be automatically generated if you enable
+   * mipmaps or anisotropic filtering with this option. They are rebuilt once,
+   * when the image is next sampled after any number of modifications.
+   * @param usage Optional uses of the image, see sga::ImageUsage. */
   SGA_API Image(int width, int height, unsigned int channels = 4,
                 ImageFormat format = ImageFormat::NInt8,
-                ImageFilterMode filtermode = ImageFilterMode::None);
+                ImageFilterMode filtermode = ImageFilterMode::None,
+                ImageUsage usage = ImageUsage::Default);
 
   SGA_API static Image createFromPNG(std::string png_path, ImageFormat format = ImageFormat::NInt8, ImageFilterMode filtermode = ImageFilterMode::None){
     return Image(png_path, format, filtermode);
   }
+  /** Creates an array image (see ImageType::Array) with the given number of
+   * layers. Other parameters are the same as for the constructor. */
+  SGA_API static Image createArray(int width, int height, unsigned int layers, unsigned int channels = 4,
+                                   ImageFormat format = ImageFormat::NInt8,
+                                   ImageFilterMode filtermode = ImageFilterMode::None,
+                                   ImageUsage usage = ImageUsage::Default){
+    return Image(width, height, layers, ImageType::Array, channels, format, filtermode, usage);
+  }
+  /** Creates a cube image (see ImageType::Cube), whose faces are `size` pixels
+   * wide and high. */
+  SGA_API static Image createCube(int size, unsigned int channels = 4,
+                                  ImageFormat format = ImageFormat::NInt8,
+                                  ImageFilterMode filtermode = ImageFilterMode::None,
+                                  ImageUsage usage = ImageUsage::Default){
+    return Image(size, size, 6, ImageType::Cube, channels, format, filtermode, usage);
+  }
   SGA_API ~Image();
 
   // TODO: Refactor these to use sizeof(datatype)
@@ -113,6 +187,41 @@ public:
     putDataRaw((uint8_t*)data.data(), data.size()*4, DataType::Float, 4);
   }
 
+  /** Writes a rectangle of `w` x `h` pixels at (`x`, `y`), leaving the rest
+   * of the image intact. Subsequent rows of the rectangle start `row_stride`
+   * values apart in `data`, which defaults to `w` times the number of
+   * channels. For array and cube images, the rectangle of each layer follows
+   * the previous one, `h` rows later. Only the rectangle is transferred to
+   * the device. */
+  SGA_API void putData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       const std::vector<uint8_t>& data, unsigned int row_stride = 0){
+    putDataRaw((uint8_t*)data.data(), data.size(), DataType::UInt, 1, x, y, w, h, size_t(row_stride) * 1);
+  }
+  SGA_API void putData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       const std::vector<uint16_t>& data, unsigned int row_stride = 0){
+    putDataRaw((uint8_t*)data.data(), data.size()*2, DataType::UInt, 2, x, y, w, h, size_t(row_stride) * 2);
+  }
+  SGA_API void putData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       const std::vector<uint32_t>& data, unsigned int row_stride = 0){
+    putDataRaw((uint8_t*)data.data(), data.size()*4, DataType::UInt, 4, x, y, w, h, size_t(row_stride) * 4);
+  }
+  SGA_API void putData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       const std::vector<int8_t>& data, unsigned int row_stride = 0){
+    putDataRaw((uint8_t*)data.data(), data.size(), DataType::SInt, 1, x, y, w, h, size_t(row_stride) * 1);
+  }
+  SGA_API void putData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       const std::vector<int16_t>& data, unsigned int row_stride = 0){
+    putDataRaw((uint8_t*)data.data(), data.size()*2, DataType::SInt, 2, x, y, w, h, size_t(row_stride) * 2);
+  }
+  SGA_API void putData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       const std::vector<int32_t>& data, unsigned int row_stride = 0){
+    putDataRaw((uint8_t*)data.data(), data.size()*4, DataType::SInt, 4, x, y, w, h, size_t(row_stride) * 4);
+  }
+  SGA_API void putData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       const std::vector<float>& data, unsigned int row_stride = 0){
+    putDataRaw((uint8_t*)data.data(), data.size()*4, DataType::Float, 4, x, y, w, h, size_t(row_stride) * 4);
+  }
+
 
   SGA_API void getData(std::vector<uint8_t>& data){
     getDataRaw((uint8_t*)data.data(), data.size(), DataType::UInt, 1);
@@ -136,15 +245,55 @@ public:
     getDataRaw((uint8_t*)data.data(), data.size()*4, DataType::Float, 4);
   }
 
+  /** Reads a rectangle of `w` x `h` pixels at (`x`, `y`) into `data`, which
+   * is laid out as for the corresponding putData. Only the rectangle is
+   * transferred from the device, and values of `data` between rows are left
+   * intact. */
+  SGA_API void getData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       std::vector<uint8_t>& data, unsigned int row_stride = 0){
+    getDataRaw((uint8_t*)data.data(), data.size(), DataType::UInt, 1, x, y, w, h, size_t(row_stride) * 1);
+  }
+  SGA_API void getData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       std::vector<uint16_t>& data, unsigned int row_stride = 0){
+    getDataRaw((uint8_t*)data.data(), data.size()*2, DataType::UInt, 2, x, y, w, h, size_t(row_stride) * 2);
+  }
+  SGA_API void getData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       std::vector<uint32_t>& data, unsigned int row_stride = 0){
+    getDataRaw((uint8_t*)data.data(), data.size()*4, DataType::UInt, 4, x, y, w, h, size_t(row_stride) * 4);
+  }
+  SGA_API void getData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       std::vector<int8_t>& data, unsigned int row_stride = 0){
+    getDataRaw((uint8_t*)data.data(), data.size(), DataType::SInt, 1, x, y, w, h, size_t(row_stride) * 1);
+  }
+  SGA_API void getData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       std::vector<int16_t>& data, unsigned int row_stride = 0){
+    getDataRaw((uint8_t*)data.data(), data.size()*2, DataType::SInt, 2, x, y, w, h, size_t(row_stride) * 2);
+  }
+  SGA_API void getData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       std::vector<int32_t>& data, unsigned int row_stride = 0){
+    getDataRaw((uint8_t*)data.data(), data.size()*4, DataType::SInt, 4, x, y, w, h, size_t(row_stride) * 4);
+  }
+  SGA_API void getData(unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                       std::vector<float>& data, unsigned int row_stride = 0){
+    getDataRaw((uint8_t*)data.data(), data.size()*4, DataType::Float, 4, x, y, w, h, size_t(row_stride) * 4);
+  }
+
   SGA_API void loadPNG(std::string filepath);
   SGA_API void savePNG(std::string filepath);
 
   SGA_API unsigned int getWidth();
   SGA_API unsigned int getHeight();
   SGA_API unsigned int getChannels();
+  /** Returns the number of layers, which is 1 for ImageType::Single images
+   * and 6 for cube images. */
+  SGA_API unsigned int getLayers();
+  SGA_API ImageType getType();
   SGA_API unsigned int getValuesN();
 
   SGA_API void setClearColor(ImageClearColor cc);
+  /** Fills the image with its clear color. The clear is deferred: if the
+      image is rendered onto next, it will be cleared by that render pass at no
+      extra cost. */
   SGA_API void clear();
 
   SGA_API void copyOnto(
@@ -154,11 +303,21 @@ public:
     int width = -1, int height = -1);
 
   friend class Pipeline;
+  friend class Bundle;
+  friend class ComputePipeline;
+  friend class PipelineChain;
 private:
   SGA_API Image(std::string png_path, ImageFormat format, ImageFilterMode filtermode);
+  SGA_API Image(int width, int height, unsigned int layers, ImageType type, unsigned int channels,
+                ImageFormat format, ImageFilterMode filtermode, ImageUsage usage);
 
   SGA_API void putDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size);
   SGA_API void getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size);
+  // Row pitch is in bytes, 0 for packed rows.
+  SGA_API void putDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                          unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch);
+  SGA_API void getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                          unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch);
 
   class Impl;
   pimpl_unique_ptr<Impl> impl;
@@ -0,0 +1,65 @@
+#ifndef __SGA_PINGPONG_HPP__
+#define __SGA_PINGPONG_HPP__
+
+#include "config.hpp"
+#include "pipeline.hpp"
+
+namespace sga{
+
+/** Runs iterative computations where each state is computed from the previous
+    one, such as simulations or cellular automata. A PingPong owns two images
+    of identical size and format. Each iteration renders one of them with a
+    full quad program that samples the other, and then they swap roles.
+
+    Both configurations are prepared only once, so an iteration costs a single
+    full quad draw. Consecutive iterations are recorded together into a single
+    command buffer, separated only by image layout transitions, and they do
+    not wait for the CPU or for each other to finish. */
+class PingPong{
+public:
+  /** Creates a PingPong with two images of the given size and format (see
+      Image::Image). Both images are initially filled with zeros. */
+  SGA_API PingPong(int width, int height, unsigned int channels = 4,
+                   ImageFormat format = ImageFormat::NInt8);
+  SGA_API ~PingPong();
+
+  /** Sets the full quad program that computes the next state.
+      @param samplerName The name of a sampler of the program that receives
+      the previous state. The program must have a single output, matching the
+      format of the images. */
+  SGA_API void setProgram(const Program&, std::string samplerName,
+                          SamplerInterpolation interpolation = SamplerInterpolation::Nearest,
+                          SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+
+  /** Binds an additional, constant image to a sampler of the program. */
+  SGA_API void setSampler(std::string, const Image&,
+                          SamplerInterpolation interpolation = SamplerInterpolation::Linear,
+                          SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+
+  /** Performs n iterations. */
+  SGA_API void iterate(unsigned int n = 1);
+
+  /** Returns the image which holds the most recent state. Its contents may be
+      modified (e.g. with Image::putData) to set the initial state. Which of
+      the two images is returned changes with each iteration. */
+  SGA_API Image& getCurrent();
+
+  //@{
+  /** Sets the value of a named uniform of the program. The value is used by
+      all subsequent iterations. */
+  #define SGA_UNIFORM_KEY const std::string&
+  #include "pipeline.uniforms.inc"
+  #undef SGA_UNIFORM_KEY
+  SGA_API void setUniform(const std::string& name, std::initializer_list<float> floats);
+  //@}
+
+private:
+  SGA_API void setUniform(DataType dt, const std::string& name, char* pData, size_t size);
+
+  class Impl;
+  pimpl_unique_ptr<Impl> impl;
+};
+
+} // namespace sga
+
+#endif // __SGA_PINGPONG_HPP__
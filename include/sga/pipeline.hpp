@@ -11,10 +11,15 @@ namespace sga{
 
 class VBO;
 class IBO;
+class StorageBuffer;
 class VertexShader;
 class FragmentShader;
 class Program;
 class Image;
+class OcclusionQuery;
+class PingPong;
+class ComputePipeline;
+class PipelineChain;
 
 enum class SamplerInterpolation{
   Nearest,
@@ -71,6 +76,51 @@ enum class BlendOperation{
   Max
 };
 
+enum class CompareOp{
+  Never,
+  Less,
+  Equal,
+  LessOrEqual,
+  Greater,
+  NotEqual,
+  GreaterOrEqual,
+  Always,
+};
+
+/** Describes how the contents of a render target are used, which lets the
+    renderer skip loading or storing them. Note that each draw call is a
+    separate render pass, so these hints apply to every single draw. */
+enum class TargetUsageHint{
+  /// Previous contents are preserved, and rendering results are kept.
+  Default,
+  /// Each draw overwrites the entire target, so its previous contents do not
+  /// need to be loaded. Only valid for color targets.
+  Overwrite,
+  /// Contents are not needed once a draw call completes. Only valid for
+  /// depth, which then only works within a single draw call. Saves memory
+  /// bandwidth and, on devices that support it, the memory of the depth image.
+  Discard,
+};
+
+/** A precompiled reference to a uniform, obtained with
+    Pipeline::getUniformHandle. Setting a uniform value using a handle avoids
+    all name lookups, which makes it the preferred way of updating uniforms
+    very frequently. A handle can only be used while the pipeline it was
+    obtained from uses the same program as at the time of obtaining it. */
+class UniformHandle{
+public:
+  UniformHandle() {}
+  /** Returns the data type the uniform was declared with. */
+  DataType getDataType() const {return type;}
+private:
+  friend class Pipeline;
+  size_t offset = 0;
+  DataType type = DataType::Float;
+  unsigned int index = 0;
+  // Identifies the program this handle refers to.
+  const void* program = nullptr;
+};
+
 /** This class represents the state and configuration of a rendering
     pipeline. Once it is configured, it may then be used for rendering onto a
     window or image surface.
@@ -83,26 +133,72 @@ public:
   /** Configures the pipeline to render onto the provided window. */
   SGA_API void setTarget(const Window& window);
 
+  /** Configures the pipeline to render onto the provided images. An image of
+      ImageFormat::Depth is used as the depth buffer instead of a color
+      target, and at most one may be given. Without it, the pipeline uses an
+      internal depth buffer. If a depth image is the only target, the pipeline
+      renders depth only and its fragment shader must have no outputs, which
+      is the cheapest way to render shadow maps. */
   SGA_API void setTarget(const Image& image) {setTarget({image});}
   SGA_API void setTarget(std::initializer_list<Image> images) {
     setTarget(std::vector<Image>(images));
   }
   SGA_API void setTarget(std::vector<Image> images);
 
+  /** Makes draws render onto a single layer of array and cube image targets
+      (see ImageType). All target images must have more than `layer` layers.
+      Ignored when rendering onto a window. */
+  SGA_API void setTargetLayer(unsigned int layer);
+  /** Makes draws render onto all layers of array and cube image targets at
+      once, which is the default. All target images must then have the same
+      number of layers. Each primitive is rendered onto the layer which the
+      vertex shader writes to `gl_Layer`, e.g. each face of a cube image may
+      be rendered by a single draw which replicates geometry for all faces.
+      Vertex shaders may only write `gl_Layer` on devices which support the
+      VK_EXT_shader_viewport_index_layer extension, on other devices such
+      programs fail to compile. Primitives of vertex shaders that do not
+      write `gl_Layer` are rendered onto the first layer. */
+  SGA_API void setTargetAllLayers();
+
   /** Performs rendering using vertex data from the provided VBO. Before
       rendering pipeline configuration is valdiated, and you will be notified of
       any errors or inconsistencies. Rendering is deferred and this function may
       return before GPU is done. */
   SGA_API void draw(const VBO&);
   SGA_API void drawIndexed(const VBO&, const IBO&);
+  /** Draws n vertices without any vertex buffer. The vertex shader must have
+      no inputs, and computes vertex attributes by itself, usually by reading
+      them from storage buffers at `gl_VertexIndex` (vertex pulling). */
+  SGA_API void drawProcedural(unsigned int n);
 
   SGA_API void clear();
 
+  /** Sets the program used for rendering. A pipeline keeps uniform values,
+      sampler bindings and compiled state separately for each program it was
+      used with, and restores them when a program is set again. This makes
+      switching between a few programs on a single pipeline cheap. */
   SGA_API void setProgram(const Program&);
 
   SGA_API void setSampler(std::string, const Image&,
                   SamplerInterpolation interpolation = SamplerInterpolation::Linear,
                   SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+  /** Binds an image to a single element of a sampler array (see
+      Shader::addSamplerArray). Elements that were never bound sample from
+      some other bound element of the same array. */
+  SGA_API void setSampler(std::string, unsigned int index, const Image&,
+                  SamplerInterpolation interpolation = SamplerInterpolation::Linear,
+                  SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+
+  /** Binds a buffer to a storage buffer of the program (see
+      Shader::addStorageBuffer). Writes made to it by shaders of a draw are
+      visible to all subsequent draws and dispatches. */
+  SGA_API void setStorageBuffer(std::string, const StorageBuffer&);
+  /** Binds an image to an input attachment of the program (see
+      FragmentShader::addInputAttachment). The image must have been created
+      with ImageUsage::InputAttachment, and be a target of an earlier pipeline
+      of the chain this pipeline belongs to (see PipelineChain), but not a
+      target of this pipeline. */
+  SGA_API void setInputAttachment(std::string, const Image&);
 
   SGA_API void setFaceCull(FaceCullMode fcm = FaceCullMode::None, FaceDirection fd = FaceDirection::Clockwise);
 
@@ -114,6 +210,72 @@ public:
   SGA_API void setBlendModeColor(BlendFactor src, BlendFactor dst, BlendOperation op = BlendOperation::Add);
   SGA_API void setBlendModeAlpha(BlendFactor src, BlendFactor dst, BlendOperation op = BlendOperation::Add);
 
+  /** Enables or disables depth testing. When disabled, all fragments pass the
+      depth test. Enabled by default. */
+  SGA_API void setDepthTest(bool enabled);
+  /** Enables or disables writing fragment depth to the depth buffer. Enabled
+      by default. */
+  SGA_API void setDepthWrite(bool enabled);
+  /** Sets the operation used for comparing fragment depth with the depth
+      buffer. A fragment passes if `fragment_depth OP buffer_depth`. The
+      default is LessOrEqual. */
+  SGA_API void setDepthCompare(CompareOp op);
+  /** Sets the format of the internal depth buffer, used when rendering onto
+      images without a depth image target. The default is D32. Raises an error
+      if the device does not support the format. */
+  SGA_API void setDepthFormat(DepthFormat format);
+  /** Sets the value the internal depth buffer is cleared with. The default is
+      1.0. Depth image targets use their own clear color instead, and windows
+      use Window::setDepthClearValue. */
+  SGA_API void setDepthClearValue(float value);
+  /** Configures depth testing for reverse-Z, where the near plane maps to
+      depth 1.0 and the far plane to 0.0. Together with a floating point depth
+      buffer this spreads precision much more evenly across the view
+      distance. This sets the depth compare op to GreaterOrEqual and clears
+      the internal depth buffer with 0.0; disabling it restores LessOrEqual
+      and 1.0. Depth image targets need to be cleared with
+      ImageClearColor::Depth(0.0), and windows with
+      Window::setDepthClearValue(0.0). The projection matrix used in shaders
+      must also map depth accordingly. */
+  SGA_API void setReverseZ(bool enabled);
+
+  /** Sets the usage hint for all image targets of this pipeline. Ignored when
+      rendering onto a window. */
+  SGA_API void setTargetUsageHint(TargetUsageHint hint);
+  /** Sets the usage hint for the depth buffer of this pipeline. Ignored when
+      rendering onto a window or a depth image. The default is Default, except
+      for FullQuadPipeline, which uses Discard. */
+  SGA_API void setDepthUsageHint(TargetUsageHint hint);
+
+  /** Enables multisample antialiasing when rendering onto images. Rendering
+      is performed into multisampled images kept by this pipeline, which are
+      resolved onto target images at the end of each draw. `samples` must be a
+      power of 2 supported by the device; 1 disables multisampling. Only
+      targets with NInt8 or Float formats can be multisampled. The internal
+      images start cleared, and keep their contents between draws, so
+      modifications made to target images by other means than clearing are
+      not visible to subsequent draws. With the Overwrite usage hint the
+      internal images do not need to be stored at all. Ignored when rendering
+      onto a window, see Window::setMultisampling instead. */
+  SGA_API void setMultisampling(unsigned int samples);
+
+  /** Makes all subsequent draws of this pipeline count samples which pass
+      depth testing into the provided query. Each draw replaces the result of
+      the previous one. */
+  SGA_API void setOcclusionQuery(const OcclusionQuery& query);
+  /** Stops counting samples into a query. */
+  SGA_API void resetOcclusionQuery();
+  /** Makes all subsequent draws of this pipeline conditional. A draw is
+      skipped if the most recent available result of the provided query
+      reports no visible samples, and performed otherwise, including when no
+      result is available yet. As results arrive with a delay of about a
+      frame, an object that becomes visible may appear a frame late. Note
+      that a pipeline using the same query for both counting and its
+      condition will never draw again once hidden. */
+  SGA_API void setDrawCondition(const OcclusionQuery& query);
+  /** Makes draws of this pipeline unconditional again. */
+  SGA_API void resetDrawCondition();
+
   SGA_API void resetViewport();
   SGA_API void setViewport(float left, float top, float right, float bottom);
 
@@ -123,8 +285,22 @@ public:
       during shader preparation. These methods will refuse to set a standard
       uniform (`u.sga*`). Using these methods is insanely fast. All changes are
       cached and writes are postponed until next render. */
+  #define SGA_UNIFORM_KEY const std::string&
   #include "pipeline.uniforms.inc"
-  SGA_API void setUniform(std::string name, std::initializer_list<float> floats);
+  #undef SGA_UNIFORM_KEY
+  SGA_API void setUniform(const std::string& name, std::initializer_list<float> floats);
+  //@}
+
+  /** Returns a handle to a named uniform, which can be used with setUniform
+      instead of the uniform name. The pipeline must have a program set. */
+  SGA_API UniformHandle getUniformHandle(const std::string& name);
+
+  //@{
+  /** Sets the value of the uniform referenced by a handle. These methods
+      perform no name lookups and no memory allocation. */
+  #define SGA_UNIFORM_KEY const UniformHandle&
+  #include "pipeline.uniforms.inc"
+  #undef SGA_UNIFORM_KEY
   //@}
 
 private:
@@ -170,8 +346,14 @@ public:
   UniformBank<UniformProxyMode::Uniform> uniform = UniformBank<UniformProxyMode::Uniform>(*this);
   UniformBank<UniformProxyMode::Sampler> sampler = UniformBank<UniformProxyMode::Sampler>(*this);
 
+  friend class PingPong;
+  friend class Bundle;
+  friend class ComputePipeline;
+  friend class PipelineChain;
+
 protected:
-  SGA_API void setUniform(DataType dt, std::string name, char* pData, size_t size);
+  SGA_API void setUniform(DataType dt, const std::string& name, char* pData, size_t size);
+  SGA_API void setUniform(DataType dt, const UniformHandle& handle, char* pData, size_t size);
 
   class Impl;
   pimpl_unique_ptr<Impl> impl_;
@@ -192,11 +374,13 @@ public:
 
   // Forbid some functions from Pipeline which make no sense for FullQuadPipeline
   SGA_API void draw(const VBO&) = delete;
+  SGA_API void drawProcedural(unsigned int n) = delete;
   SGA_API void setFaceCull(FaceCullMode fcm = FaceCullMode::None, FaceDirection fd = FaceDirection::Clockwise) = delete;
   SGA_API void setPolygonMode(PolygonMode p) = delete;
   SGA_API void setRasterizerMode(RasterizerMode r) = delete;
   SGA_API void setLineWidth(float w) = delete;
 
+  friend class Bundle;
 protected:
   class Impl;
   SGA_API Impl* impl();
@@ -0,0 +1,43 @@
+#ifndef __SGA_QUERY_HPP__
+#define __SGA_QUERY_HPP__
+
+#include <cstdint>
+
+#include "config.hpp"
+
+namespace sga{
+
+/** Counts samples which pass depth testing during draws performed by a
+    pipeline the query is attached to (see Pipeline::setOcclusionQuery). Each
+    such draw replaces the previous result. Results become available
+    asynchronously, once the device has finished the draw, which typically
+    happens by the next frame. Reading results never stalls rendering.
+
+    A query can be shared between pipelines. It is mostly useful for skipping
+    expensive draws of hidden objects with Pipeline::setDrawCondition, e.g. by
+    testing a bounding box of an object with depth writes disabled. */
+class OcclusionQuery{
+public:
+  SGA_API OcclusionQuery();
+  SGA_API ~OcclusionQuery();
+
+  /** Returns true if at least one result is available. */
+  SGA_API bool isResultAvailable();
+  /** Returns the number of samples which passed depth testing in the most
+      recent draw with an available result, or 0 if no result is available
+      yet. On devices without precise occlusion queries any non-zero value
+      only means that something was visible. */
+  SGA_API uint64_t getSamplesPassed();
+  /** Returns true if the most recent draw with an available result produced
+      any visible samples. Returns true if no result is available yet. */
+  SGA_API bool isVisible();
+
+  friend class Pipeline;
+private:
+  class Impl;
+  pimpl_unique_ptr<Impl> impl;
+};
+
+} // namespace sga
+
+#endif // __SGA_QUERY_HPP__
@@ -5,6 +5,7 @@
 
 #include "config.hpp"
 #include "layout.hpp"
+#include "image.hpp"
 
 namespace sga{
 
@@ -27,7 +28,45 @@ public:
   SGA_API void addOutput(std::initializer_list<std::pair<DataType, std::string>>);
   
   SGA_API void addUniform(DataType type, std::string name);
-  SGA_API void addSampler(std::string name);
+  /** Declares a sampler reading images of the given type, available in GLSL
+   * as `uniform sampler2D name`, `sampler2DArray` or `samplerCube`
+   * respectively (see ImageType). */
+  SGA_API void addSampler(std::string name, ImageType type = ImageType::Single);
+  /** Declares an array of `size` samplers, available in GLSL as `uniform
+   * sampler2D name[size]`. Each element may be bound to a different image
+   * (see Pipeline::setSampler), which lets a single draw sample from many
+   * textures, e.g. by reading the element index from a uniform. The index
+   * must be the same for all invocations within a draw call (dynamically
+   * uniform), so it cannot be taken from vertex attributes or other values
+   * that vary between vertices or pixels. Sampler arrays are only available
+   * on devices that support such indexing. */
+  SGA_API void addSamplerArray(std::string name, unsigned int size);
+  /** Declares a depth comparison sampler, available in GLSL as `uniform
+   * sampler2DShadow name`. It must be bound to an image of ImageFormat::Depth.
+   * `texture(name, vec3(coords, ref))` returns 1.0 where `ref` is not greater
+   * than the stored depth, and 0.0 otherwise. With linear interpolation, the
+   * results of comparisons with neighbouring texels are filtered by the
+   * hardware (percentage-closer filtering). Shadow samplers of array and cube
+   * images are `sampler2DArrayShadow` and `samplerCubeShadow`, which take the
+   * reference value as the fourth coordinate. */
+  SGA_API void addShadowSampler(std::string name, ImageType type = ImageType::Single);
+  /** Declares a storage buffer, whose elements consist of the given fields.
+   * It is available in GLSL as an array `name[]` of structs, so that e.g.
+   * `name[i].field` is a field of i-th element, and `name.length()` is the
+   * number of elements. The buffer can be written by compute shaders, and by
+   * vertex and fragment shaders if the device supports it (otherwise it is
+   * read-only in these). It must be bound to a StorageBuffer whose layout
+   * consists of the field types, in the same order. Vertex shaders can use
+   * storage buffers to fetch their input themselves, indexing them by
+   * `gl_VertexIndex` (see Pipeline::drawProcedural). A buffer declared as
+   * `readOnly` cannot be written by any shader. Draws of programs which
+   * write no storage do not wait for preceding draws, unless these wrote
+   * storage. */
+  SGA_API void addStorageBuffer(std::string name, std::initializer_list<std::pair<DataType, std::string>> fields,
+                                bool readOnly = false);
+  /** Declares a storage buffer with elements of a single type, available in
+   * GLSL as an array `name[]` of that type. */
+  SGA_API void addStorageBuffer(std::string name, DataType type, bool readOnly = false);
   
   friend class Program;
 protected:
@@ -48,6 +87,39 @@ class FragmentShader : public Shader{
 public:
   SGA_API static FragmentShader createFromFile(std::string source);
   SGA_API static FragmentShader createFromSource(std::string source);
+
+  /** Declares an input attachment, available in GLSL as `uniform
+   * subpassInput name` (`isubpassInput` or `usubpassInput` for integer
+   * formats). `subpassLoad(name)` returns the value of the attachment at the
+   * pixel being shaded, as written by an earlier pipeline of the same chain
+   * (see PipelineChain). Unlike a sampler, it cannot read other pixels. It
+   * must be bound to a color image of a matching format, created with
+   * ImageUsage::InputAttachment (see Pipeline::setInputAttachment). Programs
+   * with input attachments can only draw within a chain. */
+  SGA_API void addInputAttachment(std::string name, ImageFormat format = ImageFormat::Float);
+};
+
+/** A shader which runs on its own, outside of rendering, over a grid of work
+ * groups (see ComputePipeline::dispatch). Compute shaders have no inputs or
+ * outputs. They may declare uniforms and samplers like other shaders, and
+ * write results to storage images. */
+class ComputeShader : public Shader{
+public:
+  SGA_API static ComputeShader createFromFile(std::string source);
+  SGA_API static ComputeShader createFromSource(std::string source);
+
+  /** Sets the number of invocations in a single work group, the default is
+   * 1x1x1. Invocations of a work group run together, so groups of at least 64
+   * invocations (e.g. 8x8x1 for image processing) use the device much more
+   * efficiently. */
+  SGA_API void setWorkGroupSize(unsigned int x, unsigned int y = 1, unsigned int z = 1);
+  /** Declares a storage image, available in GLSL as `uniform image2D name`
+   * (`iimage2D` or `uimage2D` for integer formats), which can be read with
+   * `imageLoad` and written with `imageStore`. It must be bound to an image of
+   * the declared number of channels and format, created with
+   * ImageUsage::Storage (see ComputePipeline::setStorageImage). Depth images
+   * cannot be used for storage. */
+  SGA_API void addStorageImage(std::string name, unsigned int channels, ImageFormat format);
 };
 
 class Program{
@@ -56,6 +128,9 @@ public:
   SGA_API ~Program();
   SGA_API void setVertexShader(VertexShader vs);
   SGA_API void setFragmentShader(FragmentShader fs);
+  /** Sets the shader of a compute program. Compute programs have no other
+   * shaders, and may only be used with a ComputePipeline. */
+  SGA_API void setComputeShader(ComputeShader cs);
   
   SGA_API void compile();
   SGA_API void compileFullQuad();
@@ -73,9 +148,16 @@ public:
     p.compileFullQuad();
     return p;
   }
+  SGA_API static Program createAndCompile(ComputeShader cs){
+    Program p;
+    p.setComputeShader(cs);
+    p.compile();
+    return p;
+  }
   
   friend class Pipeline;
   friend class FullQuadPipeline;
+  friend class ComputePipeline;
 protected:
   class Impl;
   pimpl_unique_ptr<Impl> impl;
@@ -0,0 +1,31 @@
+#ifndef __SGA_STATISTICS_HPP__
+#define __SGA_STATISTICS_HPP__
+
+#include "config.hpp"
+
+#include <cstdint>
+
+namespace sga{
+
+/** A snapshot of internal resource usage counters. These values are mostly
+ * useful for profiling and diagnosing performance problems in your
+ * application. */
+struct Statistics{
+  /// The number of descriptor pools currently owned by SGA.
+  unsigned int descriptorPools = 0;
+  /// The total number of descriptor sets these pools can hold.
+  unsigned int descriptorSetCapacity = 0;
+  /// The number of descriptor sets allocated during the current frame.
+  unsigned int descriptorSetsInUse = 0;
+  /// The largest number of descriptor sets used in a single frame so far.
+  unsigned int descriptorSetsPeak = 0;
+  /// The total number of descriptor sets allocated since SGA was initialized.
+  uint64_t descriptorSetsAllocated = 0;
+};
+
+/** Returns current values of internal resource usage counters. */
+SGA_API Statistics getStatistics();
+
+} // namespace sga
+
+#endif // __SGA_STATISTICS_HPP__
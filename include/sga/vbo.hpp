@@ -72,6 +72,50 @@ private:
   SGA_API void putData(uint8_t* pData, unsigned int elem_n);
 };
 
+/** A buffer of n elements of the given layout, which shaders can read and
+    write. It is bound to a storage buffer declared by a shader (see
+    Shader::addStorageBuffer) with Pipeline::setStorageBuffer or
+    ComputePipeline::setStorageBuffer. Unlike uniforms, storage buffers can be
+    very large, which makes them suitable for per-object data such as
+    transforms, lights or bone matrices.
+
+    Shaders see the contents in std430 layout. Data passed to write() and
+    returned by read() is tightly packed, each element is a sequence of values
+    of types in the layout, and it is rearranged as needed. */
+class StorageBuffer{
+public:
+  SGA_API StorageBuffer(DataLayout layout, unsigned int n);
+  SGA_API ~StorageBuffer();
+
+  SGA_API DataLayout getLayout() const;
+  SGA_API unsigned int getSize() const;
+
+  /** Replaces the contents of the buffer. Waits until previously recorded
+      draws and dispatches complete. */
+  template <typename T>
+  SGA_API void write(std::vector<T> data){
+    putData((uint8_t*)data.data(), data.size(), sizeof(T));
+  }
+
+  /** Returns the contents of the buffer, including all modifications made by
+      shaders so far. Waits for the device. */
+  template <typename T>
+  SGA_API std::vector<T> read(){
+    std::vector<T> data(getSize());
+    getData((uint8_t*)data.data(), data.size(), sizeof(T));
+    return data;
+  }
+
+  friend class Pipeline;
+  friend class ComputePipeline;
+private:
+  class Impl;
+  pimpl_unique_ptr<Impl> impl;
+
+  SGA_API void putData(uint8_t* pData, size_t n_elem, size_t elem_size);
+  SGA_API void getData(uint8_t* pData, size_t n_elem, size_t elem_size);
+};
+
 } // namespace sga
 
 #endif // __SGA_VBO_HPP__
@@ -51,6 +51,21 @@ public:
   SGA_API void setOnResize(std::function<void(unsigned int, unsigned int)> f);
   
   void setClearColor(ImageClearColor cc);
+
+  /** Enables multisample antialiasing for all pipelines rendering onto this
+      window. Rendering is performed into internal multisampled images, which
+      are resolved onto the window at the end of each draw. `samples` must be
+      a power of 2 supported by the device; 1 disables multisampling. This is
+      much cheaper than rendering at a higher resolution and downsampling. */
+  SGA_API void setMultisampling(unsigned int samples);
+
+  /** Sets the format of the depth buffer of this window. The default is
+      D24S8. Raises an error if the device does not support the format. Use
+      D32 for reverse-Z, see Pipeline::setReverseZ. */
+  SGA_API void setDepthFormat(DepthFormat format);
+  /** Sets the value the depth buffer is cleared with on each frame. The
+      default is 1.0, reverse-Z requires 0.0. */
+  SGA_API void setDepthClearValue(float value);
   
   friend class Pipeline;
   friend class Image;
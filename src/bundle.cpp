@@ -0,0 +1,99 @@
+#include "bundle.impl.hpp"
+
+#include <sga/exceptions.hpp>
+#include "pipeline.impl.hpp"
+#include "image.impl.hpp"
+#include "window.impl.hpp"
+#include "global.hpp"
+#include "utils.hpp"
+#include "scheduler.hpp"
+#include "descriptors.hpp"
+#include "frame.hpp"
+
+namespace sga{
+
+Bundle::Impl::Impl(){
+  reset();
+}
+
+void Bundle::Impl::reset(){
+  segments.clear();
+  descriptors = std::make_shared<DescriptorAllocator>(false);
+}
+
+void Bundle::Impl::draw(std::shared_ptr<Pipeline::Impl> p, const VBO& vbo, const IBO* ibo){
+  if(!p->ensureValidity()) return;
+  if(p->isChainRecording())
+    PipelineConfigError("BundleInChain", "Draws of a pipeline cannot be recorded into a bundle or replayed while its chain is recording.").raise();
+  p->cook();
+  p->updateStandardUniforms();
+
+  vk::Extent2D extent = p->target_is_window ? p->targetWindow->getCurrentFramebuffer().second
+                                            : p->rp_image_target_extent;
+
+  // Consecutive draws of a pipeline onto the same targets share a segment.
+  if(segments.empty() || segments.back()->finished ||
+     segments.back()->pipeline != p || segments.back()->renderPass != p->c_renderPass ||
+     segments.back()->extent != extent){
+    auto segment = std::make_shared<Segment>();
+    segment->pipeline = p;
+    segment->renderPass = p->c_renderPass;
+    segment->extent = extent;
+    segment->descriptors = descriptors;
+    segment->commands = global::commandPool->allocateCommandBuffer(vk::CommandBufferLevel::eSecondary);
+    segment->commands->begin(vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+                             vk::CommandBufferUsageFlagBits::eSimultaneousUse,
+                             p->c_renderPass, 0);
+    segments.push_back(segment);
+  }
+
+  p->recordDraw(*segments.back(), vbo, ibo);
+}
+
+void Bundle::Impl::replay(){
+  for(const auto& s : segments){
+    replaySegment(*s);
+    Scheduler::appendChainedResource(s);
+  }
+}
+
+void Bundle::Impl::replaySegment(Segment& segment){
+  if(!segment.finished){
+    segment.commands->end();
+    segment.finished = true;
+  }
+
+  auto p = segment.pipeline;
+  p->ensureValidity();
+  if(p->isChainRecording())
+    PipelineConfigError("BundleInChain", "Draws of a pipeline cannot be recorded into a bundle or replayed while its chain is recording.").raise();
+  p->cook();
+  if(p->c_renderPass != segment.renderPass)
+    PipelineConfigError("BundleOutdated", "Targets of a pipeline have changed since it recorded draws into this bundle, the bundle must be recorded again.").raise();
+
+  for(const auto& d : segment.draws){
+    for(const auto& i : d.sampledImages){
+      i->flushClear();
+      i->flushMips();
+      i->switchLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+  }
+
+  Pipeline::Impl::TargetPass pass = p->prepareTargetPass();
+  if(pass.extent != segment.extent)
+    PipelineConfigError("BundleOutdated", "Targets of a pipeline were resized since it recorded draws into this bundle, the bundle must be recorded again.").raise();
+
+  Scheduler::borrowChainableCmdBuffer("bundle replay", [&](auto cmdBuffer){
+      global::frameUniforms->flush(cmdBuffer);
+      if(segment.storage)
+        Utils::recordShaderStorageBarrier(cmdBuffer, segment.storageWrites);
+      cmdBuffer->beginRenderPass(pass.renderPass, pass.framebuffer, vk::Rect2D({0, 0}, pass.extent),
+                                 pass.clearValues, vk::SubpassContents::eSecondaryCommandBuffers);
+      cmdBuffer->executeCommands(segment.commands);
+      cmdBuffer->endRenderPass();
+    });
+
+  p->finishTargetPass();
+}
+
+} // namespace sga
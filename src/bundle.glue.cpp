@@ -0,0 +1,33 @@
+#include <sga/bundle.hpp>
+#include "bundle.impl.hpp"
+#include "pipeline.impl.hpp"
+
+namespace sga {
+
+Bundle::Bundle()
+  : impl(std::make_shared<Bundle::Impl>()) {
+}
+
+Bundle::~Bundle() = default;
+
+void Bundle::draw(Pipeline& pipeline, const VBO& vbo){
+  impl->draw(pipeline.impl_, vbo, nullptr);
+}
+
+void Bundle::drawIndexed(Pipeline& pipeline, const VBO& vbo, const IBO& ibo){
+  impl->draw(pipeline.impl_, vbo, &ibo);
+}
+
+void Bundle::drawFullQuad(FullQuadPipeline& pipeline){
+  impl->draw(pipeline.impl_, pipeline.impl()->vbo, nullptr);
+}
+
+void Bundle::replay(){
+  impl->replay();
+}
+
+void Bundle::reset(){
+  impl->reset();
+}
+
+} // namespace sga
@@ -0,0 +1,320 @@
+#include "chain.impl.hpp"
+
+#include <algorithm>
+
+#include <sga/exceptions.hpp>
+#include "global.hpp"
+#include "utils.hpp"
+#include "image.impl.hpp"
+#include "scheduler.hpp"
+#include "descriptors.hpp"
+#include "frame.hpp"
+#include "uniformring.hpp"
+
+namespace sga{
+
+PipelineChain::Impl::Impl(){
+}
+
+PipelineChain::Impl::~Impl(){
+  if(recording){
+    global::descriptorAllocator->release();
+    global::uniformRing->release();
+  }
+  for(const auto& p : pipelines)
+    p->chain = nullptr;
+}
+
+void PipelineChain::Impl::addPipeline(std::shared_ptr<Pipeline::Impl> p){
+  if(recording)
+    PipelineConfigError("ChainRecording", "Pipelines cannot be added to a chain while it is recording.").raise();
+  if(p->chain)
+    PipelineConfigError("PipelineAlreadyChained", "A pipeline can belong to a single chain only.").raise();
+  p->chain = this;
+  p->chainSubpass = pipelines.size();
+  pipelines.push_back(p);
+  // The render pass gains a subpass.
+  c_key.clear();
+}
+
+void PipelineChain::Impl::begin(){
+  if(recording)
+    PipelineConfigError("ChainRecording", "This chain is already recording.").raise();
+  if(pipelines.empty())
+    PipelineConfigError("ChainEmpty", "Cannot record a chain with no pipelines.").raise();
+
+  prepare();
+
+  draws.assign(pipelines.size(), {});
+  for(const auto& p : pipelines)
+    p->chainDrawn = false;
+  currentSubpass = 0;
+  // Deferred draws keep using the descriptor sets and uniform values they were
+  // given, even if the device is synchronized before the chain ends.
+  global::descriptorAllocator->hold();
+  global::uniformRing->hold();
+  recording = true;
+}
+
+void PipelineChain::Impl::end(){
+  if(!recording)
+    PipelineConfigError("ChainNotRecording", "This chain is not recording, begin() must be called first.").raise();
+
+  // Attachments are switched to their layouts outside of the render pass,
+  // pending clears are performed by it.
+  uint32_t clearMask = 0;
+  std::vector<vk::ClearValue> clearValues(attachments.size());
+  for(unsigned int a = 0; a < attachments.size(); a++){
+    const auto& at = attachments[a];
+    if(at.image){
+      at.image->switchLayout(at.depth ? vk::ImageLayout::eDepthStencilAttachmentOptimal
+                                      : vk::ImageLayout::eColorAttachmentOptimal);
+      if(!at.image->pendingClear) continue;
+      clearMask |= 1u << a;
+      clearValues[a] = at.depth ? vk::ClearValue(Utils::imageClearColorToVkClearDepthStencilValue(at.image->clearColor))
+                                : vk::ClearValue(Utils::imageClearColorToVkClearColorValue(at.image->clearColor));
+      at.image->pendingClear = false;
+    }else{
+      // A discarded depth buffer must be cleared by every render pass.
+      auto p = at.depthOwner;
+      if(!p->rp_depthPendingClear && !p->depthDiscarded()) continue;
+      clearMask |= 1u << a;
+      clearValues[a] = vk::ClearValue(vk::ClearDepthStencilValue(p->depthClearValue, 0));
+      p->rp_depthPendingClear = false;
+    }
+  }
+  auto it = c_renderPassVariants.find(clearMask);
+  auto renderPass = (it != c_renderPassVariants.end()) ? it->second
+                                                       : (c_renderPassVariants[clearMask] = createRenderPass(clearMask));
+  if(!clearMask) clearValues.clear();
+
+  Scheduler::borrowChainableCmdBuffer("pipeline chain", [&](auto cmdBuffer){
+      global::frameUniforms->flush(cmdBuffer);
+      cmdBuffer->beginRenderPass(renderPass, c_framebuffer, vk::Rect2D({0, 0}, c_extent), clearValues, vk::SubpassContents::eInline);
+      for(unsigned int s = 0; s < draws.size(); s++){
+        if(s > 0) cmdBuffer->nextSubpass(vk::SubpassContents::eInline);
+        for(const auto& d : draws[s])
+          d.record(cmdBuffer);
+      }
+      cmdBuffer->endRenderPass();
+    });
+
+  for(const auto& p : pipelines)
+    p->finishTargetPass();
+
+  draws.clear();
+  recording = false;
+  global::descriptorAllocator->release();
+  global::uniformRing->release();
+}
+
+void PipelineChain::Impl::validateDraw(const Pipeline::Impl& p){
+  if(p.chainSubpass < currentSubpass)
+    PipelineConfigError("ChainOrder", "Pipelines of a chain must draw in the order they were added to it.").raise();
+#ifndef SGA_NO_RUNTIME_VALIDATION
+  // The render pass was prepared for targets and input attachments at the
+  // time the chain began.
+  const Subpass& subpass = subpasses[p.chainSubpass];
+  bool changed = p.target_is_window || p.targetImages.size() != subpass.colors.size();
+  for(unsigned int i = 0; !changed && i < subpass.colors.size(); i++)
+    changed = attachments[subpass.colors[i]].image != p.targetImages[i];
+  const auto& depth = attachments[subpass.depth];
+  if(p.depthTarget) changed = changed || depth.image != p.depthTarget;
+  else changed = changed || depth.view != p.rp_depthview;
+  auto inputs = getInputImages(p);
+  changed = changed || inputs.size() != subpass.inputs.size();
+  for(unsigned int i = 0; !changed && i < inputs.size(); i++)
+    changed = inputs[i] && attachments[subpass.inputs[i]].image != inputs[i];
+  if(changed)
+    PipelineConfigError("ChainChanged", "Targets or input attachments of a pipeline were changed while its chain was recording.").raise();
+
+  for(const auto& s : p.ps->s_samplers)
+    for(const auto& e : s.second.elements)
+      if(e.sampler && findAttachment(e.image) >= 0)
+        PipelineConfigError("InvalidSamplerImageUsage", "Images rendered by a chain cannot be sampled by its pipelines, input attachments may be used instead.").raise();
+#endif
+  currentSubpass = p.chainSubpass;
+}
+
+void PipelineChain::Impl::deferDraw(unsigned int subpass, const Pipeline::Impl::DrawCommands& draw){
+  draws[subpass].push_back(draw);
+}
+
+int PipelineChain::Impl::findAttachment(const std::shared_ptr<Image::Impl>& image) const{
+  for(unsigned int a = 0; a < attachments.size(); a++)
+    if(attachments[a].image == image) return a;
+  return -1;
+}
+
+std::vector<std::shared_ptr<Image::Impl>> PipelineChain::Impl::getInputImages(const Pipeline::Impl& p) const{
+  std::vector<std::shared_ptr<Image::Impl>> images(p.ps->s_inputAttachments.size());
+  for(const auto& ia : p.ps->s_inputAttachments)
+    images[ia.second.index] = ia.second.image;
+  return images;
+}
+
+void PipelineChain::Impl::prepare(){
+  std::vector<std::pair<const void*, int>> key;
+  for(const auto& p : pipelines){
+    p->ensureValidity();
+    if(p->target_is_window)
+      PipelineConfigError("ChainWindowTarget", "Pipelines of a chain must render onto images.").raise();
+    if(p->samples != vk::SampleCountFlagBits::e1)
+      PipelineConfigError("ChainMultisampled", "Pipelines of a chain cannot use multisampling.").raise();
+    p->prepare_renderpass();
+    p->prepare_samplers();
+    bool layered = p->depthTarget && p->depthTarget->getLayers() != 1;
+    for(const auto& i : p->targetImages)
+      layered |= (i->getLayers() != 1);
+    if(layered)
+      PipelineConfigError("ChainLayeredTarget", "Pipelines of a chain cannot render onto images with multiple layers.").raise();
+
+    for(const auto& i : p->targetImages)
+      key.push_back({i.get(), int(p->targetUsageHint)});
+    if(p->depthTarget)
+      key.push_back({p->depthTarget.get(), 0});
+    else
+      key.push_back({p->rp_depthview.get(), p->depthDiscarded()});
+    for(const auto& i : getInputImages(*p)){
+      if(!i)
+        PipelineConfigError("InputAttachmentNotSet", "A pipeline of this chain has an input attachment which was not bound to an image.").raise();
+      key.push_back({i.get(), -1});
+    }
+    key.push_back({nullptr, 0});
+  }
+  if(c_renderPass && key == c_key) return;
+
+  out_dbg("Preparing chain renderpass.");
+
+  attachments.clear();
+  subpasses.clear();
+  c_extent = pipelines[0]->rp_image_target_extent;
+  for(const auto& p : pipelines){
+    if(p->rp_image_target_extent != c_extent)
+      PipelineConfigError("TargetImageSizeMismatch", "All targets of pipelines of a chain must share identical dimensions.").raise();
+    Subpass subpass;
+    for(const auto& i : getInputImages(*p)){
+      int a = findAttachment(i);
+      if(a < 0)
+        PipelineConfigError("InputAttachmentNotRendered", "Input attachments must be targets of an earlier pipeline of the same chain.").raise();
+      subpass.inputs.push_back(a);
+    }
+    auto addImage = [&](const std::shared_ptr<Image::Impl>& image){
+      int a = findAttachment(image);
+      if(a >= 0) return uint32_t(a);
+      bool overwritten = !image->isDepth() && p->targetUsageHint == TargetUsageHint::Overwrite;
+      attachments.push_back(Attachment{image, nullptr, image->getAttachmentView(), image->format.vkFormat, image->isDepth(), overwritten});
+      return uint32_t(attachments.size() - 1);
+    };
+    for(const auto& i : p->targetImages){
+      uint32_t a = addImage(i);
+      if(std::count(subpass.inputs.begin(), subpass.inputs.end(), a))
+        PipelineConfigError("InputAttachmentIsTarget", "An image cannot be both a target and an input attachment of the same pipeline.").raise();
+      subpass.colors.push_back(a);
+    }
+    if(p->depthTarget){
+      subpass.depth = addImage(p->depthTarget);
+    }else{
+      attachments.push_back(Attachment{nullptr, p, p->rp_depthview, p->getDepthFormat(), true, false});
+      subpass.depth = attachments.size() - 1;
+    }
+    subpasses.push_back(subpass);
+  }
+  if(attachments.size() > 32)
+    PipelineConfigError("ChainTooLarge", "Pipelines of a chain can use at most 32 distinct targets and depth buffers.").raise();
+
+  // Attachments not used by a subpass must be preserved through it if they
+  // are needed after it.
+  auto uses = [&](const Subpass& s, uint32_t a){
+    return s.depth == a || std::count(s.colors.begin(), s.colors.end(), a) ||
+      std::count(s.inputs.begin(), s.inputs.end(), a);
+  };
+  for(unsigned int s = 0; s < subpasses.size(); s++){
+    for(uint32_t a = 0; a < attachments.size(); a++){
+      if(uses(subpasses[s], a)) continue;
+      bool before = false, after = false;
+      for(unsigned int t = 0; t < s; t++) before = before || uses(subpasses[t], a);
+      for(unsigned int t = s + 1; t < subpasses.size(); t++) after = after || uses(subpasses[t], a);
+      if(before && after) subpasses[s].preserve.push_back(a);
+    }
+  }
+
+  // Pipelines built for the previous render pass are no longer compatible.
+  auto previous = c_renderPass;
+  c_renderPassVariants.clear();
+  c_renderPass = c_renderPassVariants[0] = createRenderPass(0);
+  if(previous)
+    for(const auto& p : pipelines) p->clearPipelineVariants(previous);
+
+  std::vector<std::shared_ptr<vkhlf::ImageView>> views;
+  for(const auto& at : attachments) views.push_back(at.view);
+  c_framebuffer = global::device->createFramebuffer(c_renderPass, views, c_extent, 1);
+
+  c_key = key;
+}
+
+std::shared_ptr<vkhlf::RenderPass> PipelineChain::Impl::createRenderPass(uint32_t clearMask){
+  // Cleared attachments may start in any layout, loaded ones must already be
+  // in the attachment layout. Attachments end in the layout they start in.
+  std::vector<vk::AttachmentDescription> attachmentDescriptions;
+  for(uint32_t a = 0; a < attachments.size(); a++){
+    const auto& at = attachments[a];
+    bool clear = clearMask & (1u << a);
+    bool discarded = at.depthOwner && at.depthOwner->depthDiscarded();
+    bool loaded = !clear && !discarded && !at.overwritten;
+    vk::ImageLayout layout = at.depth ? vk::ImageLayout::eDepthStencilAttachmentOptimal
+                                      : vk::ImageLayout::eColorAttachmentOptimal;
+    attachmentDescriptions.push_back(vk::AttachmentDescription(
+                                       {}, at.format, vk::SampleCountFlagBits::e1,
+                                       clear ? vk::AttachmentLoadOp::eClear : (loaded ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eDontCare),
+                                       discarded ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore,
+                                       vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
+                                       loaded ? layout : vk::ImageLayout::eUndefined, layout
+                                       ));
+  }
+
+  unsigned int n = subpasses.size();
+  std::vector<std::vector<vk::AttachmentReference>> colorReferences(n), inputReferences(n);
+  std::vector<vk::AttachmentReference> depthReferences(n);
+  std::vector<vk::SubpassDescription> subpassDescriptions;
+  for(unsigned int s = 0; s < n; s++){
+    const auto& subpass = subpasses[s];
+    for(uint32_t a : subpass.colors)
+      colorReferences[s].push_back(vk::AttachmentReference(a, vk::ImageLayout::eColorAttachmentOptimal));
+    for(uint32_t a : subpass.inputs)
+      inputReferences[s].push_back(vk::AttachmentReference(a, vk::ImageLayout::eShaderReadOnlyOptimal));
+    depthReferences[s] = vk::AttachmentReference(subpass.depth, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    subpassDescriptions.push_back(vk::SubpassDescription(
+                                    {}, vk::PipelineBindPoint::eGraphics,
+                                    inputReferences[s].size(), inputReferences[s].data(),
+                                    colorReferences[s].size(), colorReferences[s].data(),
+                                    nullptr,
+                                    &depthReferences[s],
+                                    subpass.preserve.size(), subpass.preserve.data()
+                                    ));
+  }
+
+  /* Each subpass waits for attachment writes of all previous ones. These are
+   * only read at the pixel being shaded, so dependencies are framebuffer-local,
+   * which lets tiled GPUs keep attachments on-chip between subpasses. */
+  std::vector<vk::SubpassDependency> dependencies;
+  for(uint32_t dst = 1; dst < n; dst++){
+    for(uint32_t src = 0; src < dst; src++){
+      dependencies.push_back(vk::SubpassDependency(
+                               src, dst,
+                               vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                               vk::PipelineStageFlagBits::eLateFragmentTests,
+                               vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                               vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                               vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                               vk::AccessFlagBits::eInputAttachmentRead | vk::AccessFlagBits::eColorAttachmentRead |
+                               vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                               vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                               vk::DependencyFlagBits::eByRegion));
+    }
+  }
+
+  return global::device->createRenderPass(attachmentDescriptions, subpassDescriptions, dependencies);
+}
+
+} // namespace sga
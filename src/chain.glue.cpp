@@ -0,0 +1,24 @@
+#include <sga/chain.hpp>
+#include "chain.impl.hpp"
+
+namespace sga {
+
+PipelineChain::PipelineChain()
+  : impl(std::make_shared<PipelineChain::Impl>()) {
+}
+
+PipelineChain::~PipelineChain() = default;
+
+void PipelineChain::addPipeline(Pipeline& pipeline){
+  impl->addPipeline(pipeline.impl_);
+}
+
+void PipelineChain::begin(){
+  impl->begin();
+}
+
+void PipelineChain::end(){
+  impl->end();
+}
+
+} // namespace sga
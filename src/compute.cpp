@@ -0,0 +1,114 @@
+#include "compute.impl.hpp"
+
+#include <sga/exceptions.hpp>
+#include "global.hpp"
+#include "utils.hpp"
+#include "image.impl.hpp"
+#include "scheduler.hpp"
+#include "descriptors.hpp"
+#include "frame.hpp"
+
+namespace sga{
+
+ComputePipeline::Impl::Impl(){
+}
+
+void ComputePipeline::Impl::setProgram(const Program& p_){
+  auto p = p_.impl;
+  if(!p)
+    PipelineConfigError("NoProgram", "The program passed to the pipeline is empty.").raise();
+  if(!p->compiled)
+    PipelineConfigError("ProgramNotCompiled", "The program passed to the pipeline was not compiled.",
+                        "The program passed to a pipeline must be compiled first, using Program::compile() method.").raise();
+  if(!p->isCompute)
+    PipelineConfigError("InvalidProgramType", "Only compute programs are supported by this pipeline.").raise();
+
+  program = p;
+  switchProgramState(p);
+}
+
+void ComputePipeline::Impl::setStorageImage(std::string name, const Image& image_ref){
+  if(!program)
+    PipelineConfigError("NoProgram", "Cannot set storage images when no program is set.").raise();
+  std::shared_ptr<Image::Impl> image = image_ref.impl;
+
+  prepare_samplers();
+
+  auto it = ps->s_storageImages.find(name);
+  if(it == ps->s_storageImages.end())
+    PipelineConfigError("NoStorageImage", "Storage image \"" + name + "\" does not exist.").raise();
+  const auto& declared = program->c_storageImages[name];
+  if(image->getChannels() != declared.channels || image->userFormat != declared.format)
+    PipelineConfigError("StorageImageFormatMismatch", "The format of the image does not match the declaration of storage image \"" + name + "\".").raise();
+  if(!image->supportsStorage)
+    PipelineConfigError("StorageUsageMissing", "Only images created with ImageUsage::Storage can be bound to storage images.").raise();
+  if(image->hasMipmaps())
+    PipelineConfigError("StorageImageMipmapped", "Images with mipmaps cannot be bound to storage images.").raise();
+  if(image->getLayers() != 1)
+    PipelineConfigError("StorageImageLayered", "Images with multiple layers cannot be bound to storage images.").raise();
+
+  it->second.image = image;
+
+  // The new binding will be written to a fresh descriptor set on next dispatch.
+  ps->d_descriptorSetDirty = true;
+  ps->bindings_validated = false;
+}
+
+void ComputePipeline::Impl::prepareStorageImages(){
+  for(const auto& s : ps->s_storageImages){
+    auto image = s.second.image;
+    for(const auto& sampler : ps->s_samplers)
+      for(const auto& e : sampler.second.elements)
+        if(e.image == image)
+          PipelineConfigError("InvalidStorageImageUsage", "An image cannot be both sampled and used for storage in the same dispatch.").raise();
+    image->flushClear();
+    image->switchLayout(vk::ImageLayout::eGeneral);
+  }
+}
+
+std::shared_ptr<vkhlf::Pipeline> ComputePipeline::Impl::getComputePipeline(){
+  if(!ps->c_computePipeline){
+    out_dbg("Cooking a compute pipeline.");
+    vkhlf::PipelineShaderStageCreateInfo stage(
+      vk::ShaderStageFlagBits::eCompute, program->c_CS_shader, "main");
+    ps->c_computePipeline = global::device->createComputePipeline(
+      global::pipelineCache, {}, stage, program->c_pipelineLayout, nullptr, 0);
+  }
+  return ps->c_computePipeline;
+}
+
+void ComputePipeline::Impl::dispatch(unsigned int x, unsigned int y, unsigned int z){
+  if(!program)
+    PipelineConfigError("ProgramNotSet", "This pipeline cannot dispatch, the program was not set.").raise();
+  const auto& limits = global::deviceLimits;
+  if(x > limits.maxComputeWorkGroupCount[0] || y > limits.maxComputeWorkGroupCount[1] || z > limits.maxComputeWorkGroupCount[2])
+    PipelineConfigError("TooManyWorkGroups", "The device does not support dispatching " + std::to_string(x) + "x" + std::to_string(y) + "x" + std::to_string(z) + " work groups.").raise();
+  if(x == 0 || y == 0 || z == 0) return;
+
+  ensureBindingsValidity();
+
+  prepareSampledImages();
+  prepareStorageImages();
+
+  acquire_descset();
+  auto pipeline = getComputePipeline();
+
+  bool hasStorage = hasShaderStorage();
+  bool writesStorage = writesShaderStorage();
+  Scheduler::borrowChainableCmdBuffer("compute dispatch", [&](auto cmdBuffer){
+      global::frameUniforms->flush(cmdBuffer);
+      recordUniformUpload(cmdBuffer);
+
+      // Storage images stay in the general layout between dispatches, and
+      // buffers have no layouts, so no transition orders their accesses.
+      if(hasStorage)
+        Utils::recordShaderStorageBarrier(cmdBuffer, writesStorage);
+
+      cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+      cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, program->c_pipelineLayout, 0,
+                                    {ps->d_descriptorSet, global::frameUniforms->getSet()}, nullptr);
+      cmdBuffer->dispatch(x, y, z);
+    });
+}
+
+} // namespace sga
@@ -0,0 +1,45 @@
+#include <sga/compute.hpp>
+#include "compute.impl.hpp"
+
+namespace sga {
+
+ComputePipeline::ComputePipeline() : impl(std::make_shared<ComputePipeline::Impl>()) {
+}
+
+ComputePipeline::~ComputePipeline() = default;
+
+void ComputePipeline::setProgram(const Program& program){
+  impl->setProgram(program);
+}
+
+void ComputePipeline::setSampler(std::string name, const Image& image,
+                                 SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
+  impl->setSampler(name, image, interpolation, warp_mode);
+}
+
+void ComputePipeline::setSampler(std::string name, unsigned int index, const Image& image,
+                                 SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
+  impl->setSampler(name, index, image, interpolation, warp_mode);
+}
+
+void ComputePipeline::setStorageImage(std::string name, const Image& image){
+  impl->setStorageImage(name, image);
+}
+
+void ComputePipeline::setStorageBuffer(std::string name, const StorageBuffer& buffer){
+  impl->setStorageBuffer(name, buffer);
+}
+
+void ComputePipeline::dispatch(unsigned int x, unsigned int y, unsigned int z){
+  impl->dispatch(x, y, z);
+}
+
+void ComputePipeline::setUniform(const std::string& name, std::initializer_list<float> floats){
+  impl->setUniform(name, floats);
+}
+
+void ComputePipeline::setUniform(DataType dt, const std::string& name, char* pData, size_t size){
+  impl->setUniform(dt, name, pData, size);
+}
+
+} // namespace sga
@@ -0,0 +1,132 @@
+#include "descriptors.hpp"
+
+#include <algorithm>
+
+#include "global.hpp"
+#include "utils.hpp"
+#include "scheduler.hpp"
+
+namespace sga{
+
+// The number of sets in the first pool. Each subsequent pool is twice as large
+// as the previous one, until the size limit is reached.
+static const unsigned int initialPoolSets = 64;
+static const unsigned int maxPoolSets = 1024;
+
+// When sizing a new pool, assume each set will use at least this many
+// descriptors of each type that was ever requested.
+static unsigned int defaultDescriptorsPerSet(vk::DescriptorType type){
+  switch(type){
+  case vk::DescriptorType::eCombinedImageSampler: return 4;
+  default: return 1;
+  }
+}
+
+bool DescriptorAllocator::Pool::fits(const Requirements& r) const{
+  if(setsLeft == 0) return false;
+  for(const auto& p : r){
+    auto it = left.find(p.first);
+    unsigned int available = (it == left.end()) ? 0 : it->second;
+    if(available < p.second) return false;
+  }
+  return true;
+}
+
+DescriptorAllocator::DescriptorAllocator(bool perFrame) :
+  perFrame(perFrame){
+  if(perFrame) frame = Scheduler::getSyncCount();
+}
+
+DescriptorAllocator::~DescriptorAllocator(){
+}
+
+uint64_t DescriptorAllocator::getFrame(){
+  retireFrameIfNeeded();
+  return frame;
+}
+
+bool DescriptorAllocator::isCurrent(uint64_t f){
+  retireFrameIfNeeded();
+  return f == frame;
+}
+
+void DescriptorAllocator::release(){
+  if(--holds == 0 && perFrame) frame = Scheduler::getSyncCount();
+}
+
+unsigned int DescriptorAllocator::getSetCapacity() const{
+  unsigned int total = 0;
+  for(const auto& p : pools) total += p.maxSets;
+  return total;
+}
+
+void DescriptorAllocator::retireFrameIfNeeded(){
+  if(!perFrame || holds) return;
+  uint64_t current = Scheduler::getSyncCount();
+  if(current == frame) return;
+
+  // All command buffers that might have used sets from the previous frame
+  // have completed, so the pools can be recycled in bulk.
+  for(auto& p : pools){
+    if(p.setsLeft == p.maxSets) continue;
+    static_cast<vk::Device>(*global::device).resetDescriptorPool(static_cast<vk::DescriptorPool>(*p.pool));
+    p.setsLeft = p.maxSets;
+    p.left = p.capacity;
+  }
+  currentPool = 0;
+  setsInUse = 0;
+  frame = current;
+}
+
+void DescriptorAllocator::growPools(const Requirements& requirements){
+  unsigned int maxSets = std::min(initialPoolSets << std::min<size_t>(pools.size(), 16), maxPoolSets);
+
+  // Size the new pool for all descriptor types seen so far, so that it is
+  // useful for other pipelines as well.
+  Requirements perSet;
+  for(const auto& p : pools)
+    for(const auto& c : p.capacity)
+      perSet[c.first] = std::max(perSet[c.first], c.second / p.maxSets);
+  for(const auto& r : requirements)
+    perSet[r.first] = std::max({perSet[r.first], r.second, defaultDescriptorsPerSet(r.first)});
+
+  Pool pool;
+  pool.maxSets = pool.setsLeft = maxSets;
+  std::vector<vk::DescriptorPoolSize> sizes;
+  for(const auto& p : perSet){
+    if(p.second == 0) continue;
+    pool.capacity[p.first] = p.second * maxSets;
+    sizes.push_back(vk::DescriptorPoolSize(p.first, p.second * maxSets));
+  }
+  pool.left = pool.capacity;
+
+  out_dbg("Creating a new descriptor pool for " + std::to_string(maxSets) + " sets.");
+  // Sets are never freed individually, pools are always reset as a whole.
+  pool.pool = global::device->createDescriptorPool({}, maxSets, sizes);
+
+  pools.push_back(pool);
+}
+
+std::shared_ptr<vkhlf::DescriptorSet> DescriptorAllocator::allocate(std::shared_ptr<vkhlf::DescriptorSetLayout> layout,
+                                                                    const Requirements& requirements){
+  retireFrameIfNeeded();
+
+  // Find a pool that can hold this set. Pools before currentPool are known to
+  // be full.
+  unsigned int i = currentPool;
+  while(i < pools.size() && !pools[i].fits(requirements)) i++;
+  if(i == pools.size()) growPools(requirements);
+
+  Pool& pool = pools[i];
+  auto set = global::device->allocateDescriptorSet(pool.pool, layout);
+  pool.setsLeft--;
+  for(const auto& r : requirements) pool.left[r.first] -= r.second;
+  if(pool.setsLeft == 0 && i == currentPool) currentPool++;
+
+  setsInUse++;
+  setsPeak = std::max(setsPeak, setsInUse);
+  setsAllocatedTotal++;
+  return set;
+}
+
+} // namespace sga
@@ -0,0 +1,139 @@
+#include "frame.hpp"
+
+#include <cstring>
+
+#include <sga/exceptions.hpp>
+#include "global.hpp"
+#include "utils.hpp"
+#include "layout.hpp"
+#include "scheduler.hpp"
+#include "descriptors.hpp"
+
+namespace sga{
+
+FrameUniformBlock::FrameUniformBlock(){
+  std::vector<vkhlf::DescriptorSetLayoutBinding> dslbs;
+  dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer,
+                                                    vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute, nullptr));
+  setLayout = global::device->createDescriptorSetLayout(dslbs);
+  allocator = std::make_shared<DescriptorAllocator>(false);
+
+  timeOffset = 0;
+  entries["sgaTime"] = Entry{timeOffset, DataType::Float};
+  order.push_back("sgaTime");
+  values.resize(getDataTypeSize(DataType::Float));
+}
+
+void FrameUniformBlock::addUniform(DataType type, std::string name){
+  if(locked)
+    ProgramConfigError("FrameUniformsLocked", "Cannot add frame uniform \"" + name + "\", frame uniforms must be declared before any program is compiled.").raise();
+  if(name.compare(0, 3, "sga") == 0)
+    ProgramConfigError("UniformNameReserved", "Cannot add an uniform using a reserved name", "Uniforms with names beginning with `sga` have a special meaning, and you cannot declare your own").raise();
+  if(!isVariableNameValid(name))
+    ProgramConfigError("UniformNameInvalid", "Cannot use \"" + name + "\" for the identifier of a uniform, it must be a valid C indentifier.").raise();
+  if(hasUniform(name))
+    ProgramConfigError("UniformRedefined", "Frame uniform \"" + name + "\" was already declared.").raise();
+
+  size_t offset = align(values.size(), getDataTypeGLSLstd140Alignment(type));
+  entries[name] = Entry{offset, type};
+  order.push_back(name);
+  values.resize(offset + getDataTypeSize(type), 0);
+}
+
+void FrameUniformBlock::setUniform(DataType dt, const std::string& name, char* pData, size_t size){
+  if(size != getDataTypeSize(dt))
+    DataFormatError("UniformSizeMismatch", "setUniform failed: Provided input has different size than declared data type!").raise();
+  if(name.compare(0, 3, "sga") == 0)
+    PipelineConfigError("SpecialUniform", "Cannot set the value of a standard uniform.", "Uniforms with names beginning with `sga` have a special meaning, and you cannot manually assign values to them.").raise();
+  auto it = entries.find(name);
+  if(it == entries.end())
+    PipelineConfigError("NoUniform", "Frame uniform \"" + name + "\" does not exist.").raise();
+  if(it->second.type != dt)
+    DataFormatError("UniformDataTypeMimatch", "The data type of frame uniform " + name + " is different than the value written to it.").raise();
+
+  memcpy(values.data() + it->second.offset, pData, size);
+  dirty = true;
+}
+
+void FrameUniformBlock::setUniform(const std::string& name, std::initializer_list<float> floats){
+  switch(floats.size()){
+  case 1:  setUniform(DataType::Float,  name, (char*)floats.begin(), 1*4); break;
+  case 2:  setUniform(DataType::Float2, name, (char*)floats.begin(), 2*4); break;
+  case 3:  setUniform(DataType::Float3, name, (char*)floats.begin(), 3*4); break;
+  case 4:  setUniform(DataType::Float4, name, (char*)floats.begin(), 4*4); break;
+  case 9:  setUniform(DataType::Mat3,   name, (char*)floats.begin(), 9*4); break;
+  case 16: setUniform(DataType::Mat4,   name, (char*)floats.begin(), 16*4); break;
+  default:
+    DataFormatError("SetUniformInitializerList", "Unable to automatically deduce data type from an initializer list used for setUniform, please use a more specific type (like std::array, glm::vec etc.)").raise();
+  }
+}
+
+void FrameUniformBlock::lock(){
+  if(locked) return;
+  // Block size is a multiple of its largest alignment under std140.
+  values.resize(align(values.size(), 16), 0);
+  if(values.size() > global::deviceLimits.maxUniformBufferRange)
+    ProgramConfigError("FrameUniformsTooLarge", "Frame uniforms take " + std::to_string(values.size()) + " bytes, but the device supports uniform blocks of at most " + std::to_string(global::deviceLimits.maxUniformBufferRange) + " bytes.").raise();
+
+  buffer = global::device->createBuffer(
+    values.size(),
+    vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eUniformBuffer,
+    vk::SharingMode::eExclusive,
+    nullptr,
+    vk::MemoryPropertyFlagBits::eDeviceLocal);
+  set = allocator->allocate(setLayout, {{vk::DescriptorType::eUniformBuffer, 1}});
+  global::device->updateDescriptorSets(
+    vkhlf::WriteDescriptorSet(set, 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr,
+                              vkhlf::DescriptorBufferInfo(buffer, 0, values.size())),
+    nullptr);
+
+  locked = true;
+}
+
+std::string FrameUniformBlock::getCode(){
+  lock();
+  std::string code = "layout(std140, set = 1, binding = 0) uniform sga_frame {\n";
+  for(const auto& name : order)
+    code += "  " + getDataTypeGLSLName(entries[name].type) + " sgaFrame_" + name + ";\n";
+  code += "} sgaFrame;\n\n";
+  for(const auto& name : order)
+    code += "#define " + name + " sgaFrame.sgaFrame_" + name + "\n";
+  return code;
+}
+
+void FrameUniformBlock::flush(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer){
+  lock();
+  uint64_t frame = Scheduler::getSyncCount();
+  if(frame != uploadFrame){
+    float time = getTime();
+    memcpy(values.data() + timeOffset, &time, sizeof(time));
+    uploadFrame = frame;
+    dirty = true;
+  }
+  if(!dirty) return;
+
+  Utils::recordUniformBufferUpdate(cmdBuffer, buffer, 0, values.size(), values.data());
+  dirty = false;
+}
+
+// ====== FrameUniforms ======
+
+static FrameUniformBlock* getFrameUniformBlock(){
+  if(!global::initialized)
+    SystemError("NotInitialized", "libSGA was not initialized, please call sga::init() first!").raise();
+  return global::frameUniforms.get();
+}
+
+void FrameUniforms::addUniform(DataType type, std::string name){
+  getFrameUniformBlock()->addUniform(type, name);
+}
+
+void FrameUniforms::setUniform(const std::string& name, std::initializer_list<float> floats){
+  getFrameUniformBlock()->setUniform(name, floats);
+}
+
+void FrameUniforms::setUniform(DataType dt, const std::string& name, char* pData, size_t size){
+  getFrameUniformBlock()->setUniform(dt, name, pData, size);
+}
+
+} // namespace sga
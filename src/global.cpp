@@ -1,4 +1,5 @@
 #include "global.hpp"
+#include "descriptors.hpp"
 
 namespace sga{
 
@@ -10,8 +11,17 @@ std::shared_ptr<vkhlf::Instance> global::instance;
 std::shared_ptr<vkhlf::PhysicalDevice> global::physicalDevice;
 std::shared_ptr<vkhlf::Device> global::device;
 std::shared_ptr<vkhlf::CommandPool> global::commandPool;
+std::shared_ptr<DescriptorAllocator> global::descriptorAllocator;
+std::shared_ptr<StagingRing> global::stagingRing;
+std::shared_ptr<FrameUniformBlock> global::frameUniforms;
+std::shared_ptr<UniformRing> global::uniformRing;
+std::shared_ptr<vkhlf::PipelineCache> global::pipelineCache;
 
 unsigned int global::queueFamilyIndex;
+vk::PhysicalDeviceFeatures global::deviceFeatures;
+vk::PhysicalDeviceLimits global::deviceLimits;
+bool global::lazilyAllocatedMemory = false;
+bool global::vertexShaderLayer = false;
 
 std::shared_ptr<vkhlf::DebugReportCallback> global::debugReportCallback;
 
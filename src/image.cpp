@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cmath>
 #include <functional>
+#include <cstring>
 
 #include <sga/exceptions.hpp>
 #include "stbi.hpp"
@@ -11,11 +12,13 @@
 #include "global.hpp"
 #include "utils.hpp"
 #include "scheduler.hpp"
+#include "staging.hpp"
 
 namespace sga{
 
-Image::Impl::Impl(unsigned int width, unsigned int height, unsigned int ch, ImageFormat f, ImageFilterMode filtermode) :
-  width(width), height(height), channels(ch), filtermode(filtermode), clearColor(f,ch) {
+Image::Impl::Impl(unsigned int width, unsigned int height, unsigned int ch, ImageFormat f, ImageFilterMode filtermode, ImageType type, unsigned int layers,
+                  ImageUsage usage) :
+  width(width), height(height), channels(ch), type(type), layers(layers), filtermode(filtermode), clearColor(f,ch) {
   if(!global::initialized){
     SystemError("NotInitialized", "libSGA was not initialized, please call sga::init() first!").raise();
   }
@@ -23,6 +26,16 @@ Image::Impl::Impl(unsigned int width, unsigned int height, unsigned int ch, Imag
     ImageFormatError("ZeroChannelImage", "An image must have at least one channel.").raise();
   if(ch > 4)
     ImageFormatError("TooManyChannels", "An image must have at most four channels.").raise();
+  if((f == ImageFormat::Depth || f == ImageFormat::Depth16) && ch != 1)
+    ImageFormatError("DepthImageChannels", "A depth image must have exactly one channel.").raise();
+  if(layers == 0)
+    ImageFormatError("ZeroLayerImage", "An image must have at least one layer.").raise();
+  if(layers > global::deviceLimits.maxImageArrayLayers)
+    ImageFormatError("TooManyLayers", "An image may have at most " + std::to_string(global::deviceLimits.maxImageArrayLayers) + " layers on this device.").raise();
+  if(type == ImageType::Single && layers != 1)
+    ImageFormatError("SingleImageLayers", "An image that is not an array or cube must have a single layer.").raise();
+  if(type == ImageType::Cube && (layers != 6 || width != height))
+    ImageFormatError("CubeImageShape", "A cube image must have six square layers.").raise();
   
   userFormat = f;
   format = getFormatProperties(channels, userFormat);
@@ -30,21 +43,38 @@ Image::Impl::Impl(unsigned int width, unsigned int height, unsigned int ch, Imag
   if(hasMipmaps() && !format.supports_blit){
     ImageFormatError("MipmapsUnsupported", "This format does not support mipmaps").raise();
   }
+  if(isDepth())
+    Utils::ensureDepthFormatSupport(format.vkFormat);
   
+  if(usage & ImageUsage::Storage){
+    vk::FormatProperties props = global::physicalDevice->getFormatProperties(format.vkFormat);
+    if(isDepth() || !(props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage))
+      ImageFormatError("StorageUnsupported", "This device does not support storage images of this format.").raise();
+    supportsStorage = true;
+  }
+  if(usage & ImageUsage::InputAttachment){
+    if(isDepth())
+      ImageFormatError("InputAttachmentUnsupported", "Depth images cannot be used as input attachments.").raise();
+    supportsInputAttachment = true;
+  }
+
   unsigned int mipsno = hasMipmaps() ? getDesiredMipsNo() : 1;
   image = global::device->createImage(
-    vk::ImageCreateFlags(),
+    (type == ImageType::Cube) ? vk::ImageCreateFlags(vk::ImageCreateFlagBits::eCubeCompatible) : vk::ImageCreateFlags(),
     vk::ImageType::e2D,
     format.vkFormat,
     vk::Extent3D(width, height, 1),
     mipsno,
-    1,
+    layers,
     vk::SampleCountFlagBits::e1,
     vk::ImageTiling::eOptimal,
     vk::ImageUsageFlagBits::eTransferDst |
     vk::ImageUsageFlagBits::eTransferSrc |
-    vk::ImageUsageFlagBits::eColorAttachment | 
-    vk::ImageUsageFlagBits::eSampled ,
+    (isDepth() ? vk::ImageUsageFlagBits::eDepthStencilAttachment :
+                 vk::ImageUsageFlagBits::eColorAttachment) |
+    vk::ImageUsageFlagBits::eSampled |
+    (supportsStorage ? vk::ImageUsageFlagBits::eStorage : vk::ImageUsageFlags()) |
+    (supportsInputAttachment ? vk::ImageUsageFlagBits::eInputAttachment : vk::ImageUsageFlags()),
     vk::SharingMode::eExclusive,
     std::vector<uint32_t>(), // queue family indices
     vk::ImageLayout::ePreinitialized,
@@ -57,14 +87,23 @@ Image::Impl::Impl(unsigned int width, unsigned int height, unsigned int ch, Imag
   switchLayout(vk::ImageLayout::eGeneral);
 
   // Clear image.
-  std::vector<uint8_t> data(N_pixels() * format.pixelSize, 0);
-  putDataRaw(data.data(), data.size(), format.transferDataType, format.pixelSize/channels);
+  if(isDepth()){
+    // Depth images start at the far plane.
+    clearColor = ImageClearColor::Depth(1.0f);
+    clearNow();
+  }else{
+    std::vector<uint8_t> data(N_pixels() * format.pixelSize, 0);
+    putDataRaw(data.data(), data.size(), format.transferDataType, format.pixelSize/channels);
+  }
 
-  regenerateMips();
+  invalidateMips();
 
   vk::ComponentMapping components = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA };
-  vk::ImageSubresourceRange subresRange = { vk::ImageAspectFlagBits::eColor, 0, mipsno, 0, 1 };
-  image_view = image->createImageView(vk::ImageViewType::e2D, format.vkFormat, components, subresRange);
+  vk::ImageSubresourceRange subresRange = { getAspect(), 0, mipsno, 0, layers };
+  vk::ImageViewType viewType = vk::ImageViewType::e2D;
+  if(type == ImageType::Array) viewType = vk::ImageViewType::e2DArray;
+  if(type == ImageType::Cube) viewType = vk::ImageViewType::eCube;
+  image_view = image->createImageView(viewType, format.vkFormat, components, subresRange);
   
   out_dbg("Image prepared.");
 
@@ -114,24 +153,120 @@ const FormatProperties& getFormatProperties(unsigned int channels, ImageFormat f
     {{4,ImageFormat::SInt32}, {vk::Format::eR32G32B32A32Sint,   DataType::SInt4,  DataType::SInt,  16, 16, {csR, csG, csB, csA}, true}},
     {{4,ImageFormat::UInt32}, {vk::Format::eR32G32B32A32Uint,   DataType::UInt4,  DataType::UInt,  16, 16, {csR, csG, csB, csA}, true}},
     {{4,ImageFormat::Float},  {vk::Format::eR32G32B32A32Sfloat, DataType::Float4, DataType::Float, 16, 16, {csR, csG, csB, csA}, true}},
+
+    {{1,ImageFormat::Depth},   {vk::Format::eD32Sfloat, DataType::Float, DataType::Float, 4, 4, {csR, cs0, cs0, cs1}, false}},
+    {{1,ImageFormat::Depth16}, {vk::Format::eD16Unorm,  DataType::Float, DataType::UInt,  2, 2, {csR, cs0, cs0, cs1}, false}},
   };
   auto it = m.find({channels,format});
   if(it == m.end()){
     // If the implementation is correct, this should not happen.
-    ImageFormatError("InvalidFormat", "This combination of channel and format is invalid");
+    ImageFormatError("InvalidFormat", "This combination of channel and format is invalid").raise();
   }
   return it->second;
 }
 
+std::string getStorageFormatQualifier(unsigned int channels, ImageFormat format){
+  // Three channel images use four channel formats.
+  static std::map<vk::Format, std::string> m = {
+    {vk::Format::eR8Sint,             "r8i"},
+    {vk::Format::eR8Unorm,            "r8"},
+    {vk::Format::eR8Uint,             "r8ui"},
+    {vk::Format::eR16Sint,            "r16i"},
+    {vk::Format::eR16Uint,            "r16ui"},
+    {vk::Format::eR32Sint,            "r32i"},
+    {vk::Format::eR32Uint,            "r32ui"},
+    {vk::Format::eR32Sfloat,          "r32f"},
+    {vk::Format::eR8G8Sint,           "rg8i"},
+    {vk::Format::eR8G8Unorm,          "rg8"},
+    {vk::Format::eR8G8Uint,           "rg8ui"},
+    {vk::Format::eR16G16Sint,         "rg16i"},
+    {vk::Format::eR16G16Uint,         "rg16ui"},
+    {vk::Format::eR32G32Sint,         "rg32i"},
+    {vk::Format::eR32G32Uint,         "rg32ui"},
+    {vk::Format::eR32G32Sfloat,       "rg32f"},
+    {vk::Format::eR8G8B8A8Sint,       "rgba8i"},
+    {vk::Format::eR8G8B8A8Unorm,      "rgba8"},
+    {vk::Format::eR8G8B8A8Uint,       "rgba8ui"},
+    {vk::Format::eR16G16B16A16Sint,   "rgba16i"},
+    {vk::Format::eR16G16B16A16Uint,   "rgba16ui"},
+    {vk::Format::eR32G32B32A32Sint,   "rgba32i"},
+    {vk::Format::eR32G32B32A32Uint,   "rgba32ui"},
+    {vk::Format::eR32G32B32A32Sfloat, "rgba32f"},
+  };
+  auto it = m.find(getFormatProperties(channels, format).vkFormat);
+  if(it == m.end())
+    ImageFormatError("StorageFormatInvalid", "Images of this format cannot be used for storage.").raise();
+  return it->second;
+}
+
+std::shared_ptr<vkhlf::ImageView> Image::Impl::getAttachmentView(){
+  if(!hasMipmaps()) return image_view;
+  if(!attachment_view){
+    vk::ComponentMapping components = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA };
+    attachment_view = image->createImageView(vk::ImageViewType::e2D, format.vkFormat, components, { getAspect(), 0, 1, 0, 1 });
+  }
+  return attachment_view;
+}
+
+std::shared_ptr<vkhlf::ImageView> Image::Impl::getTargetView(int layer){
+  if(layers == 1) return getAttachmentView();
+  auto it = target_views.find(layer);
+  if(it != target_views.end()) return it->second;
+  vk::ComponentMapping components = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA };
+  std::shared_ptr<vkhlf::ImageView> view;
+  if(layer < 0)
+    view = image->createImageView(vk::ImageViewType::e2DArray, format.vkFormat, components, getBaseRange());
+  else
+    view = image->createImageView(vk::ImageViewType::e2D, format.vkFormat, components, { getAspect(), 0, 1, uint32_t(layer), 1 });
+  target_views[layer] = view;
+  return view;
+}
+
+// Returns the pipeline stages and memory accesses that may touch an image in
+// the given layout.
+static std::pair<vk::PipelineStageFlags, vk::AccessFlags> getLayoutUsage(vk::ImageLayout il){
+  switch(il){
+  case vk::ImageLayout::eUndefined:
+    return {vk::PipelineStageFlagBits::eTopOfPipe, {}};
+  case vk::ImageLayout::ePreinitialized:
+    return {vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostWrite};
+  case vk::ImageLayout::eTransferSrcOptimal:
+    return {vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead};
+  case vk::ImageLayout::eTransferDstOptimal:
+    return {vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite};
+  case vk::ImageLayout::eColorAttachmentOptimal:
+    return {vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite};
+  case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+    return {vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite};
+  case vk::ImageLayout::eShaderReadOnlyOptimal:
+    return {vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader |
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eShaderRead};
+  default:
+    return {vk::PipelineStageFlagBits::eAllCommands,
+            vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite};
+  }
+}
+
 void Image::Impl::switchLayout(vk::ImageLayout target_layout){
   if(target_layout == current_layout) return;
 
-  //out_dbg("Image requires layout switch.");
-  vk::ImageSubresourceRange subresRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
-  Scheduler::buildAndSubmitSynced("Switching image layout", [&](auto cmdBuffer){
-      vkhlf::setImageLayout(
-        cmdBuffer, image, subresRange, current_layout, target_layout);
+  /* The transition is recorded into the chained command buffer, so that
+   * alternating an image between being rendered to and sampled does not wait
+   * for the device each time. Synced actions sync the chain first, so
+   * transfers still see the image in the layout they expect. */
+  vk::ImageSubresourceRange subresRange = getBaseRange();
+  auto src = getLayoutUsage(current_layout);
+  auto dst = getLayoutUsage(target_layout);
+  vkhlf::ImageMemoryBarrier barrier(
+    src.second, dst.second, current_layout, target_layout,
+    VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, subresRange);
+  Scheduler::borrowChainableCmdBuffer("Switching image layout", [&](auto cmdBuffer){
+      cmdBuffer->pipelineBarrier(src.first, dst.first, {}, nullptr, nullptr, barrier);
     });
+  Scheduler::appendChainedResource(image);
 
   current_layout = target_layout;
 }
@@ -143,248 +278,168 @@ void Image::Impl::withLayout(vk::ImageLayout il, std::function<void()> f){
   switchLayout(orig_layout);
 }
 
+// Copies rows of pixels between buffers which hold them at different strides
+// (between pixels) and pitches (between rows).
+static void copyPixelRows(uint8_t* RESTRICT dst, size_t dst_pitch, size_t dst_stride,
+                          const uint8_t* RESTRICT src, size_t src_pitch, size_t src_stride,
+                          size_t pixel_size, size_t row_pixels, size_t rows){
+  size_t row_size = row_pixels * pixel_size;
+  bool packed_pixels = (dst_stride == pixel_size && src_stride == pixel_size);
+  if(packed_pixels && dst_pitch == row_size && src_pitch == row_size){
+    memcpy(dst, src, rows * row_size);
+    return;
+  }
+  for(size_t y = 0; y < rows; y++){
+    if(packed_pixels){
+      memcpy(dst, src, row_size);
+    }else{
+      uint8_t* RESTRICT d = dst;
+      const uint8_t* RESTRICT q = src;
+      for(size_t x = 0; x < row_pixels; x++){
+        memcpy(d, q, pixel_size);
+        d += dst_stride;
+        q += src_stride;
+      }
+    }
+    dst += dst_pitch;
+    src += src_pitch;
+  }
+}
+
+size_t Image::Impl::checkRegion(size_t n, size_t value_size, unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch) const{
+  if(x + w > width || y + h > height || x + w < x || y + h < y)
+    ImageFormatError("RegionOutOfBounds", "The region " + std::to_string(w) + "x" + std::to_string(h) + " at (" + std::to_string(x) + ", " + std::to_string(y) + ") does not fit within the " + std::to_string(width) + "x" + std::to_string(height) + " image.").raise();
+  if(row_pitch == 0) row_pitch = w * format.pixelSize;
+  if(row_pitch < w * format.pixelSize)
+    ImageFormatError("RegionRowStrideTooSmall", "The row stride of image data must be at least the width of the region times the number of channels.").raise();
+  // Rectangles of subsequent layers follow each other.
+  size_t rows = size_t(h) * layers;
+  size_t needed = rows ? (rows - 1) * row_pitch + w * format.pixelSize : 0;
+  if(n < needed)
+    ImageFormatError("RegionDataTooSmall", "Image data for the region has " + std::to_string(n / value_size) + " values, expected at least " + std::to_string(needed / value_size) + ".").raise();
+  return row_pitch;
+}
+
 void Image::Impl::putDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size){
   if(n != N_pixels() * format.pixelSize)
-    ImageFormatError("InvalidPutDataSize", "Data for Image::putData has " + std::to_string(n) + " values, expected " + std::to_string(N_pixels() * format.pixelSize) + ".").raise();
+    ImageFormatError("InvalidPutDataSize", "Data for Image::putData has " + std::to_string(n / value_size) + " values, expected " + std::to_string(N_pixels() * format.pixelSize / value_size) + ".").raise();
+  putDataRaw(data, n, dtype, value_size, 0, 0, width, height, 0);
+}
+
+void Image::Impl::putDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                             unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch){
   if(dtype != format.transferDataType || value_size * channels != format.pixelSize)
     //TODO: State what would be the right variable to use for this image format
     ImageFormatError("InvalidPutDataType", "Data for Image::putData has type that does not match image format.").raise();
+  row_pitch = checkRegion(n, value_size, x, y, w, h, row_pitch);
+  if(w == 0 || h == 0) return;
 
-  auto stagingImage = image->get<vkhlf::Device>()->createImage(
-    {},
-    image->getType(),
-    image->getFormat(),
-    image->getExtent(),
-    1,
-    image->getArrayLayers(),
-    image->getSamples(),
-    vk::ImageTiling::eLinear,
-    vk::ImageUsageFlagBits::eTransferSrc,
-    image->getSharingMode(),
-    image->getQueueFamilyIndices(),
-    vk::ImageLayout::ePreinitialized,
-    vk::MemoryPropertyFlagBits::eHostVisible,
-    nullptr, image->get<vkhlf::Allocator>());
-      
-  Scheduler::buildAndSubmitSynced("Preparing staging image layout", [&](auto cmdBuffer){
-      vkhlf::setImageLayout(
-        cmdBuffer, stagingImage, vk::ImageAspectFlagBits::eColor,
-        vk::ImageLayout::ePreinitialized, vk::ImageLayout::eGeneral);
-    });
-
-  size_t data_size = width * height * format.stride;
-  char* mapped_data = (char*)stagingImage->get<vkhlf::DeviceMemory>()->map(0, data_size);
-  
-  vk::SubresourceLayout layout = stagingImage->getSubresourceLayout(vk::ImageAspectFlagBits::eColor, 0, 0);
-
-  // This pointer walks over mapped memory.
-  uint8_t* RESTRICT q_mapped_row = reinterpret_cast<uint8_t*>(mapped_data);
-  uint8_t* RESTRICT q_mapped_px;
-  // This pointer walks over host memory.
-  uint8_t* RESTRICT q_data = reinterpret_cast<uint8_t*>(data);
-    
-  if(value_size == 1){
-    for (size_t y = 0; y < height; y++){
-      q_mapped_px = q_mapped_row;
-      for (size_t x = 0; x < width; x++){
-        auto p_mapped = (uint8_t*)q_mapped_px;
-        auto p_data = (uint8_t*)q_data;
-        for(size_t c = 0; c < channels; c++){
-          p_mapped[c] = p_data[c];
-        }
-        q_mapped_px += format.stride;
-        q_data += format.pixelSize;
-      }
-      q_mapped_row += layout.rowPitch;
-    }
-  }else if(value_size == 2){
-    for (size_t y = 0; y < height; y++){
-      q_mapped_px = q_mapped_row;
-      for (size_t x = 0; x < width; x++){
-        auto p_mapped = (uint16_t*)q_mapped_px;
-        auto p_data = (uint16_t*)q_data;
-        for(size_t c = 0; c < channels; c++){
-          p_mapped[c] = p_data[c];
-        }
-        q_mapped_px += format.stride;
-        q_data += format.pixelSize;
-      }
-      q_mapped_row += layout.rowPitch;
-    }
-  }else if(value_size == 4){
-    for (size_t y = 0; y < height; y++){
-      q_mapped_px = q_mapped_row;
-      for (size_t x = 0; x < width; x++){
-        auto p_mapped = (uint32_t*)q_mapped_px;
-        auto p_data = (uint32_t*)q_data;
-        for(size_t c = 0; c < channels; c++){
-          p_mapped[c] = p_data[c];
-        }
-        q_mapped_px += format.stride;
-        q_data += format.pixelSize;
-      }
-      q_mapped_row += layout.rowPitch;
-    }
+  if(x == 0 && y == 0 && w == width && h == height){
+    // The entire image is overwritten, no need to clear it.
+    pendingClear = false;
   }else{
-    assert(false);
+    flushClear();
   }
-  
-  stagingImage->get<vkhlf::DeviceMemory>()->flush(0, data_size);
-  stagingImage->get<vkhlf::DeviceMemory>()->unmap();
 
+  // The staging buffer holds tightly packed rows of the region in all layers,
+  // with pixels at the stride of the image format.
+  size_t region_pitch = w * format.stride;
+  auto region = global::stagingRing->allocate(region_pitch * h * layers);
+  copyPixelRows(region.data, region_pitch, format.stride, data, row_pitch, format.pixelSize,
+                format.pixelSize, w, size_t(h) * layers);
+
+  // The copy does not wait for the device, it is performed before any
+  // subsequent use of the image.
   withLayout(vk::ImageLayout::eTransferDstOptimal, [&](){
-      Scheduler::buildAndSubmitSynced("Copying staging image to main image", [&](auto cmdBuffer){
-          // Switch staging image layout
-          vkhlf::setImageLayout(
-            cmdBuffer, stagingImage, vk::ImageAspectFlagBits::eColor,
-            vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal);
-          // Perform copy
-          cmdBuffer->copyImage(
-            stagingImage, vk::ImageLayout::eTransferSrcOptimal,
-            image, vk::ImageLayout::eTransferDstOptimal,
-            vk::ImageCopy(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
-                          vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
-                          image->getExtent()
-              )
-            );
-        }); // execute one time commands
+      Scheduler::borrowChainableCmdBuffer("Copying staging buffer to image", [&](auto cmdBuffer){
+          cmdBuffer->copyBufferToImage(
+            region.buffer, image, vk::ImageLayout::eTransferDstOptimal,
+            vk::BufferImageCopy(region.offset, w, h, vk::ImageSubresourceLayers(getAspect(), 0, 0, layers),
+                                vk::Offset3D(x, y, 0), vk::Extent3D(w, h, 1)));
+        });
+      Scheduler::appendChainedResource(region.buffer);
     }); // with layout
 
-  regenerateMips();
+  invalidateMips();
 }
 
 void Image::Impl::getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size){
   if(n != N_pixels() * format.pixelSize )
-    ImageFormatError("InvalidGetDataSize", "Data for Image::getData has " + std::to_string(n) + " values, expected " + std::to_string(N_pixels() * format.pixelSize) + ".").raise();
+    ImageFormatError("InvalidGetDataSize", "Data for Image::getData has " + std::to_string(n / value_size) + " values, expected " + std::to_string(N_pixels() * format.pixelSize / value_size) + ".").raise();
+  getDataRaw(data, n, dtype, value_size, 0, 0, width, height, 0);
+}
+
+void Image::Impl::getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                             unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch){
   if(dtype != format.transferDataType || value_size * channels != format.pixelSize)
     //TODO: State what would be the right variable to use for this image format
     ImageFormatError("InvalidGetDataType", "Data for Image::getData has type that does not match image format.").raise();
-  
-  auto stagingImage = image->get<vkhlf::Device>()->createImage(
-    {},
-    image->getType(),
-    image->getFormat(),
-    image->getExtent(),
-    image->getMipLevels(),
-    image->getArrayLayers(),
-    image->getSamples(),
-    vk::ImageTiling::eLinear,
-    vk::ImageUsageFlagBits::eTransferDst,
-    image->getSharingMode(),
-    image->getQueueFamilyIndices(),
-    vk::ImageLayout::ePreinitialized,
-    vk::MemoryPropertyFlagBits::eHostVisible,
-    nullptr, image->get<vkhlf::Allocator>());
+  row_pitch = checkRegion(n, value_size, x, y, w, h, row_pitch);
+  if(w == 0 || h == 0) return;
+
+  flushClear();
 
+  size_t region_pitch = w * format.stride;
+  auto region = global::stagingRing->allocate(region_pitch * h * layers);
 
   withLayout(vk::ImageLayout::eTransferSrcOptimal, [&](){
-      Scheduler::buildAndSubmitSynced("Copying main image to staging image", [&](auto cmdBuffer){
-          vkhlf::setImageLayout(
-            cmdBuffer, stagingImage, vk::ImageAspectFlagBits::eColor,
-            vk::ImageLayout::ePreinitialized, vk::ImageLayout::eTransferDstOptimal);
-          cmdBuffer->copyImage(
-            image, vk::ImageLayout::eTransferSrcOptimal,
-            stagingImage, vk::ImageLayout::eTransferDstOptimal,
-            vk::ImageCopy(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
-                          vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
-                          image->getExtent()
-              )
-            );
-          vkhlf::setImageLayout(
-            cmdBuffer, stagingImage, vk::ImageAspectFlagBits::eColor,
-            vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eGeneral);
+      Scheduler::buildAndSubmitSynced("Copying image to staging buffer", [&](auto cmdBuffer){
+          cmdBuffer->copyImageToBuffer(
+            image, vk::ImageLayout::eTransferSrcOptimal, region.buffer,
+            vk::BufferImageCopy(region.offset, w, h, vk::ImageSubresourceLayers(getAspect(), 0, 0, layers),
+                                vk::Offset3D(x, y, 0), vk::Extent3D(w, h, 1)));
+          // Make the copied data visible to the host.
+          cmdBuffer->pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {},
+            vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead),
+            nullptr, nullptr);
         }); // one time commands
     }); // with layout
 
-
-
-  size_t data_size = width * height * format.stride;
-  char* mapped_data = (char*)stagingImage->get<vkhlf::DeviceMemory>()->map(0, data_size);
-  
-
-  // TODO: It might be better to test subresource layout (rowPitch, stride, etc) instead of using custom hardcoded values.
-  
-  vk::SubresourceLayout layout = stagingImage->getSubresourceLayout(vk::ImageAspectFlagBits::eColor, 0, 0);
-
-  // This pointer walks over mapped memory.
-  uint8_t* RESTRICT q_mapped_row = reinterpret_cast<uint8_t*>(mapped_data);
-  uint8_t* RESTRICT q_mapped_px;
-  // This pointer walks over host memory.
-  uint8_t* RESTRICT q_data = reinterpret_cast<uint8_t*>(data);
-    
-  if(value_size == 1){
-    for (size_t y = 0; y < height; y++){
-      q_mapped_px = q_mapped_row;
-      for (size_t x = 0; x < width; x++){
-        auto p_mapped = (uint8_t*)q_mapped_px;
-        auto p_data = (uint8_t*)q_data;
-        for(size_t c = 0; c < channels; c++){
-          p_data[c] = p_mapped[c];
-        }
-        q_mapped_px += format.stride;
-        q_data += format.pixelSize;
-      }
-      q_mapped_row += layout.rowPitch;
-    }
-  }else if(value_size == 2){
-    for (size_t y = 0; y < height; y++){
-      q_mapped_px = q_mapped_row;
-      for (size_t x = 0; x < width; x++){
-        auto p_mapped = (uint16_t*)q_mapped_px;
-        auto p_data = (uint16_t*)q_data;
-        for(size_t c = 0; c < channels; c++){
-          p_data[c] = p_mapped[c];
-        }
-        q_mapped_px += format.stride;
-        q_data += format.pixelSize;
-      }
-      q_mapped_row += layout.rowPitch;
-    }
-  }else if(value_size == 4){
-    for (size_t y = 0; y < height; y++){
-      q_mapped_px = q_mapped_row;
-      for (size_t x = 0; x < width; x++){
-        auto p_mapped = (uint32_t*)q_mapped_px;
-        auto p_data = (uint32_t*)q_data;
-        for(size_t c = 0; c < channels; c++){
-          p_data[c] = p_mapped[c];
-        }
-        q_mapped_px += format.stride;
-        q_data += format.pixelSize;
-      }
-      q_mapped_row += layout.rowPitch;
-    }
-  }else{
-    assert(false);
-  }
-  
-  stagingImage->get<vkhlf::DeviceMemory>()->unmap();
+  copyPixelRows(data, row_pitch, format.pixelSize, region.data, region_pitch, format.stride,
+                format.pixelSize, w, size_t(h) * layers);
 }
 
 void Image::Impl::setClearColor(ImageClearColor cc){
   if(cc.getComponents() != channels)
     ImageFormatError("ClearChannelMismatch", "The clear color used for clearning this image has " + std::to_string(cc.getComponents()) + " values, while the image has " + std::to_string(channels) + " channels.").raise();
   // TODO: Print out human-readable format name!
-  if(cc.getFormat() != userFormat)
+  // All depth images are cleared with Depth clear colors.
+  ImageFormat clearFormat = isDepth() ? ImageFormat::Depth : userFormat;
+  if(cc.getFormat() != clearFormat)
     ImageFormatError("ClearFormatMismatch", "The clear color used for clearning this image uses a different format than the image itself.").raise();
 
   clearColor = cc;
 }
 
 void Image::Impl::clear(){
+  pendingClear = true;
+}
+
+void Image::Impl::flushClear(){
+  if(pendingClear) clearNow();
+}
+
+void Image::Impl::clearNow(){
+  pendingClear = false;
   Scheduler::buildAndSubmitSynced("Clearing image", [&](std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer){
       vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
+        cmdBuffer, image, getBaseRange(),
         vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
       
-      vk::ClearColorValue vcc = Utils::imageClearColorToVkClearColorValue(clearColor);
-      cmdBuffer->clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, vcc);
+      if(isDepth()){
+        vk::ClearDepthStencilValue vdc = Utils::imageClearColorToVkClearDepthStencilValue(clearColor);
+        cmdBuffer->clearDepthStencilImage(image, vk::ImageLayout::eTransferDstOptimal, vdc.depth, vdc.stencil, getBaseRange());
+      }else{
+        vk::ClearColorValue vcc = Utils::imageClearColorToVkClearColorValue(clearColor);
+        cmdBuffer->clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, vcc, getBaseRange());
+      }
       
       vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
+        cmdBuffer, image, getBaseRange(),
         vk::ImageLayout::eTransferDstOptimal, current_layout);
     });
-  regenerateMips();
+  invalidateMips();
 }
 
 static void correct_bounds(
@@ -426,12 +481,21 @@ void Image::Impl::copyOnto(std::shared_ptr<Image> target,
   if(cwidth < 0) cwidth = image->getExtent().width;
   if(cheight < 0) cheight = image->getExtent().height;
 
+  if(isDepth() != target->impl->isDepth())
+    ImageFormatError("CopyFormatMismatch", "Depth images can only be copied onto other depth images.").raise();
+
   auto target_image = target->impl->image;
   int twidth = target_image->getExtent().width;
   int theight = target_image->getExtent().height;
 
   correct_bounds(source_x, source_y, target_x, target_y,
                  cwidth, cheight, width, height, twidth, theight);
+
+  // Layers present in both images are copied.
+  unsigned int clayers = std::min(layers, target->impl->layers);
+
+  flushClear();
+  target->impl->flushClear();
   
   Scheduler::buildAndSubmitSynced("Copying from image to image", [&](auto cmdBuffer){
       
@@ -439,33 +503,33 @@ void Image::Impl::copyOnto(std::shared_ptr<Image> target,
       auto target_orig_layout = target->impl->current_layout;
       
       vkhlf::setImageLayout(
-        cmdBuffer, target_image, vk::ImageAspectFlagBits::eColor,
+        cmdBuffer, target_image, target->impl->getBaseRange(),
         target_orig_layout, vk::ImageLayout::eTransferDstOptimal);
 
       vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
+        cmdBuffer, image, getBaseRange(),
         source_orig_layout, vk::ImageLayout::eTransferSrcOptimal);
       
       cmdBuffer->copyImage(
         image, vk::ImageLayout::eTransferSrcOptimal,
         target_image, vk::ImageLayout::eTransferDstOptimal,
-        vk::ImageCopy(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(source_x, source_y, 0),
-                      vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(target_x, target_y, 0),
+        vk::ImageCopy(vk::ImageSubresourceLayers(getAspect(), 0, 0, clayers), vk::Offset3D(source_x, source_y, 0),
+                      vk::ImageSubresourceLayers(getAspect(), 0, 0, clayers), vk::Offset3D(target_x, target_y, 0),
                       vk::Extent3D(cwidth, cheight, 0)
           )
         );
       
       vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
+        cmdBuffer, image, getBaseRange(),
         vk::ImageLayout::eTransferSrcOptimal, source_orig_layout);
         
       vkhlf::setImageLayout(
-        cmdBuffer, target_image, vk::ImageAspectFlagBits::eColor,
+        cmdBuffer, target_image, target->impl->getBaseRange(),
           vk::ImageLayout::eTransferDstOptimal, target_orig_layout);
       
     });
 
-  target->impl->regenerateMips();
+  target->impl->invalidateMips();
 }
 
 
@@ -495,6 +559,8 @@ void Image::Impl::loadPNG(std::string filepath){
 }
 
 void Image::Impl::loadPNGInternal(uint8_t* stbi_data){
+  if(layers != 1)
+    ImageFormatError("LayeredImagePNG", "PNG files can only be loaded into images with a single layer.").raise();
   if(userFormat != ImageFormat::NInt8 && userFormat != ImageFormat::UInt8)
     ImageFormatError("LoadPNGFormatMismatch", "Loading images from PNG supports only NInt8 and UInt8 images.").raise();
   putDataRaw(stbi_data, width * height * channels, DataType::UInt, 1);
@@ -503,6 +569,8 @@ void Image::Impl::loadPNGInternal(uint8_t* stbi_data){
 void Image::Impl::savePNG(std::string filepath){
   if(userFormat != ImageFormat::NInt8 && userFormat != ImageFormat::UInt8)
     ImageFormatError("LoadPNGFormatMismatch", "Saving images to PNG supports only NInt8 and UInt8 images.").raise();
+  if(layers != 1)
+    ImageFormatError("LayeredImagePNG", "Only images with a single layer can be saved to PNG files.").raise();
 
   // TODO: Support floats?
   
@@ -517,9 +585,14 @@ unsigned int Image::Impl::getDesiredMipsNo() const{
   return std::floor(std::log2(std::max(width, height))) + 1;
 }
 
+void Image::Impl::flushMips(){
+  if(mipsDirty) regenerateMips();
+}
+
 void Image::Impl::regenerateMips(){
   if(!hasMipmaps())
     return;
+  mipsDirty = false;
 
   unsigned int mipsno = getDesiredMipsNo();
   out_dbg("Regenerating image mipmaps (" + std::to_string(mipsno) + " levels)");
@@ -532,7 +605,7 @@ void Image::Impl::regenerateMips(){
         
         // Source
         imageBlit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-        imageBlit.srcSubresource.layerCount = 1;
+        imageBlit.srcSubresource.layerCount = layers;
         imageBlit.srcSubresource.mipLevel = i-1;
         imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
         imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
@@ -540,13 +613,13 @@ void Image::Impl::regenerateMips(){
         
         // Destination
         imageBlit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-        imageBlit.dstSubresource.layerCount = 1;
+        imageBlit.dstSubresource.layerCount = layers;
         imageBlit.dstSubresource.mipLevel = i;
         imageBlit.dstOffsets[1].x = int32_t(width >> i);
         imageBlit.dstOffsets[1].y = int32_t(height >> i);
         imageBlit.dstOffsets[1].z = 1;
         
-        vk::ImageSubresourceRange mipSubresRange = { vk::ImageAspectFlagBits::eColor, i, 1, 0, 1 };
+        vk::ImageSubresourceRange mipSubresRange = { vk::ImageAspectFlagBits::eColor, i, 1, 0, layers };
         
         // Transiton current mip level to transfer dest
         vkhlf::setImageLayout(cmdBuffer, image, mipSubresRange, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
@@ -561,7 +634,7 @@ void Image::Impl::regenerateMips(){
       }
 
       // Transition all mip levels to shader read.
-      vk::ImageSubresourceRange allSubresRange = { vk::ImageAspectFlagBits::eColor, 0, mipsno, 0, 1 };
+      vk::ImageSubresourceRange allSubresRange = { vk::ImageAspectFlagBits::eColor, 0, mipsno, 0, layers };
       vkhlf::setImageLayout(cmdBuffer, image, allSubresRange, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
       current_layout = vk::ImageLayout::eShaderReadOnlyOptimal;
     }); // Scheduler::buildSubmitAndSync
@@ -3,8 +3,12 @@
 
 namespace sga {
 
-Image::Image(int width, int height, unsigned int ch, ImageFormat format, ImageFilterMode filtermode)
-  : impl(std::make_shared<Image::Impl>(width, height, ch, format, filtermode)) {
+Image::Image(int width, int height, unsigned int ch, ImageFormat format, ImageFilterMode filtermode, ImageUsage usage)
+  : impl(std::make_shared<Image::Impl>(width, height, ch, format, filtermode, ImageType::Single, 1, usage)) {
+}
+
+Image::Image(int width, int height, unsigned int layers, ImageType type, unsigned int ch, ImageFormat format, ImageFilterMode filtermode, ImageUsage usage)
+  : impl(std::make_shared<Image::Impl>(width, height, ch, format, filtermode, type, layers, usage)) {
 }
 
 Image::Image(std::string png_path, ImageFormat format, ImageFilterMode filtermode)
@@ -21,6 +25,16 @@ void Image::getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t va
   impl->getDataRaw(data, n, dtype, value_size);
 }
 
+void Image::putDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                       unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch) {
+  impl->putDataRaw(data, n, dtype, value_size, x, y, w, h, row_pitch);
+}
+
+void Image::getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                       unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch) {
+  impl->getDataRaw(data, n, dtype, value_size, x, y, w, h, row_pitch);
+}
+
 void Image::loadPNG(std::string filepath) {
   impl->loadPNG(filepath);
 }
@@ -56,6 +70,14 @@ unsigned int Image::getChannels() {
   return impl->getChannels();
 }
 
+unsigned int Image::getLayers() {
+  return impl->getLayers();
+}
+
+ImageType Image::getType() {
+  return impl->getType();
+}
+
 unsigned int Image::getValuesN() {
   return impl->getValuesN();
 }
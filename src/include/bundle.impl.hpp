@@ -0,0 +1,61 @@
+#ifndef __BUNDLE_IMPL_HPP__
+#define __BUNDLE_IMPL_HPP__
+
+#include <sga/bundle.hpp>
+#include <sga/pipeline.hpp>
+#include <sga/image.hpp>
+#include <sga/vbo.hpp>
+
+#include <vkhlf/vkhlf.h>
+
+#include <vector>
+
+namespace sga{
+
+class DescriptorAllocator;
+
+class Bundle::Impl{
+public:
+  Impl();
+
+  void draw(std::shared_ptr<Pipeline::Impl> pipeline, const VBO& vbo, const IBO* ibo);
+  void replay();
+  void reset();
+
+  struct Draw{
+    std::vector<std::shared_ptr<Image::Impl>> sampledImages;
+  };
+
+  /* A run of consecutive draws recorded by a single pipeline onto the same
+   * targets. These are recorded into a secondary command buffer, which is
+   * executed within a render pass begun by the pipeline on each replay. */
+  struct Segment{
+    std::shared_ptr<Pipeline::Impl> pipeline;
+    std::shared_ptr<vkhlf::RenderPass> renderPass;
+    vk::Extent2D extent;
+    std::shared_ptr<vkhlf::CommandBuffer> commands;
+    // Recording is finished on first replay.
+    bool finished = false;
+    std::vector<Draw> draws;
+    // Whether any draw may access storage buffers, and whether any may write
+    // them.
+    bool storage = false;
+    bool storageWrites = false;
+    // Objects referenced by recorded commands.
+    std::vector<std::shared_ptr<void>> resources;
+    // Shared by all segments of a bundle.
+    std::shared_ptr<DescriptorAllocator> descriptors;
+  };
+
+private:
+  // Recorded descriptor sets are never modified, and stay valid for as long
+  // as the bundle keeps its draws.
+  std::shared_ptr<DescriptorAllocator> descriptors;
+  // Segments are shared with the scheduler while their commands execute.
+  std::vector<std::shared_ptr<Segment>> segments;
+  void replaySegment(Segment& segment);
+};
+
+} // namespace sga
+
+#endif // __BUNDLE_IMPL_HPP__
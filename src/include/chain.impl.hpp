@@ -0,0 +1,80 @@
+#ifndef __CHAIN_IMPL_HPP__
+#define __CHAIN_IMPL_HPP__
+
+#include <sga/chain.hpp>
+
+#include <vkhlf/vkhlf.h>
+
+#include "pipeline.impl.hpp"
+
+#include <vector>
+#include <map>
+
+namespace sga{
+
+class PipelineChain::Impl{
+public:
+  Impl();
+  ~Impl();
+
+  void addPipeline(std::shared_ptr<Pipeline::Impl> p);
+  void begin();
+  void end();
+
+  // Ensures a draw of a pipeline matches the render pass of this chain.
+  void validateDraw(const Pipeline::Impl& p);
+  // Stores commands of a draw, recorded into its subpass by end().
+  void deferDraw(unsigned int subpass, const Pipeline::Impl::DrawCommands& draw);
+
+  bool recording = false;
+  // The render pass pipelines of this chain are built for.
+  std::shared_ptr<vkhlf::RenderPass> c_renderPass;
+
+private:
+  // Pipelines in subpass order.
+  std::vector<std::shared_ptr<Pipeline::Impl>> pipelines;
+  std::vector<std::vector<Pipeline::Impl::DrawCommands>> draws;
+  // The subpass of the most recent draw.
+  unsigned int currentSubpass = 0;
+
+  /* Attachments of the render pass are all distinct target images of the
+   * pipelines, and internal depth images of those that have no depth target,
+   * in the order of first use. */
+  struct Attachment{
+    // Null for internal depth images.
+    std::shared_ptr<Image::Impl> image;
+    // The pipeline an internal depth image belongs to.
+    std::shared_ptr<Pipeline::Impl> depthOwner;
+    std::shared_ptr<vkhlf::ImageView> view;
+    vk::Format format;
+    bool depth;
+    // Set if the first pipeline that renders onto it overwrites it entirely.
+    bool overwritten;
+  };
+  std::vector<Attachment> attachments;
+  struct Subpass{
+    std::vector<uint32_t> colors;
+    uint32_t depth;
+    // In the order of input_attachment_index.
+    std::vector<uint32_t> inputs;
+    // Attachments written before and read after this subpass.
+    std::vector<uint32_t> preserve;
+  };
+  std::vector<Subpass> subpasses;
+  int findAttachment(const std::shared_ptr<Image::Impl>& image) const;
+
+  /* The render pass is rebuilt whenever targets or input attachments of any
+   * pipeline change. Variants which clear some attachments are compatible
+   * with c_renderPass. */
+  void prepare();
+  std::vector<std::shared_ptr<Image::Impl>> getInputImages(const Pipeline::Impl& p) const;
+  std::vector<std::pair<const void*, int>> c_key;
+  std::shared_ptr<vkhlf::RenderPass> createRenderPass(uint32_t clearMask);
+  std::map<uint32_t, std::shared_ptr<vkhlf::RenderPass>> c_renderPassVariants;
+  std::shared_ptr<vkhlf::Framebuffer> c_framebuffer;
+  vk::Extent2D c_extent;
+};
+
+} // namespace sga
+
+#endif // __CHAIN_IMPL_HPP__
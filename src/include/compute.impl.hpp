@@ -0,0 +1,29 @@
+#ifndef __COMPUTE_IMPL_HPP__
+#define __COMPUTE_IMPL_HPP__
+
+#include <sga/compute.hpp>
+
+#include "pipeline.impl.hpp"
+
+namespace sga{
+
+/* Reuses the program state of pipelines (uniforms, samplers and descriptor
+ * sets), but none of their target and render pass handling. */
+class ComputePipeline::Impl : public Pipeline::Impl{
+public:
+  Impl();
+
+  void setProgram(const Program&) override;
+  void setStorageImage(std::string name, const Image& image);
+  void dispatch(unsigned int x, unsigned int y, unsigned int z);
+
+  friend class ComputePipeline;
+private:
+  // Makes images bound to storage images ready for shader access.
+  void prepareStorageImages();
+  std::shared_ptr<vkhlf::Pipeline> getComputePipeline();
+};
+
+} // namespace sga
+
+#endif // __COMPUTE_IMPL_HPP__
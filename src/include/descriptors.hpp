@@ -0,0 +1,80 @@
+#ifndef __DESCRIPTORS_HPP__
+#define __DESCRIPTORS_HPP__
+
+#include <vkhlf/vkhlf.h>
+
+#include <map>
+
+namespace sga{
+
+/* Hands out descriptor sets from a small number of shared, growable descriptor
+ * pools, instead of creating a dedicated pool for each set.
+ *
+ * A per-frame allocator ties the lifetime of all sets it allocates to the
+ * current frame, i.e. the period between two Scheduler syncs. Once the frame
+ * retires, the GPU is guaranteed not to use any of these sets anymore, so all
+ * pools are reset in bulk and recycled for the next frame. Users must check
+ * isCurrent() before reusing a set they have previously received.
+ *
+ * An allocator that is not per-frame never resets its pools, sets it hands out
+ * stay valid for as long as the allocator lives. */
+class DescriptorAllocator{
+public:
+  // The number of descriptors of each type required by a single set.
+  typedef std::map<vk::DescriptorType, unsigned int> Requirements;
+
+  DescriptorAllocator(bool perFrame);
+  ~DescriptorAllocator();
+
+  std::shared_ptr<vkhlf::DescriptorSet> allocate(std::shared_ptr<vkhlf::DescriptorSetLayout> layout,
+                                                 const Requirements& requirements);
+
+  // Returns the identifier of the frame sets are currently allocated for.
+  uint64_t getFrame();
+  // Returns true iff sets allocated during the given frame are still valid.
+  bool isCurrent(uint64_t frame);
+
+  /* While held, the current frame does not retire on syncs. This keeps valid
+   * the sets used by commands that are recorded only later. On release, the
+   * sets are carried over to the frame that is current by then. */
+  void hold() {holds++;}
+  void release();
+
+  unsigned int getPoolsNo() const {return pools.size();}
+  unsigned int getSetCapacity() const;
+  unsigned int getSetsInUse() const {return setsInUse;}
+  unsigned int getSetsPeak() const {return setsPeak;}
+  uint64_t getSetsAllocatedTotal() const {return setsAllocatedTotal;}
+
+private:
+  struct Pool{
+    std::shared_ptr<vkhlf::DescriptorPool> pool;
+    unsigned int maxSets;
+    unsigned int setsLeft;
+    Requirements capacity;
+    Requirements left;
+
+    bool fits(const Requirements& r) const;
+  };
+
+  // Creates a new pool, large enough to satisfy at least the given request.
+  void growPools(const Requirements& requirements);
+  // Resets all pools, if the frame they were used by has retired.
+  void retireFrameIfNeeded();
+
+  const bool perFrame;
+  uint64_t frame = 0;
+  unsigned int holds = 0;
+
+  std::vector<Pool> pools;
+  // Index of the first pool that may still have free space.
+  unsigned int currentPool = 0;
+
+  unsigned int setsInUse = 0;
+  unsigned int setsPeak = 0;
+  uint64_t setsAllocatedTotal = 0;
+};
+
+} // namespace sga
+
+#endif // __DESCRIPTORS_HPP__
@@ -0,0 +1,64 @@
+#ifndef __FRAME_HPP__
+#define __FRAME_HPP__
+
+#include <sga/frame.hpp>
+
+#include <vkhlf/vkhlf.h>
+
+#include <map>
+#include <vector>
+
+namespace sga{
+
+class DescriptorAllocator;
+
+/* Keeps frame uniforms (see FrameUniforms) in a single uniform buffer. The
+ * block is bound as descriptor set 1 by all pipelines, set 0 holds
+ * per-pipeline uniforms and samplers. */
+class FrameUniformBlock{
+public:
+  FrameUniformBlock();
+
+  void addUniform(DataType type, std::string name);
+  void setUniform(DataType dt, const std::string& name, char* pData, size_t size);
+  void setUniform(const std::string& name, std::initializer_list<float> floats);
+
+  bool hasUniform(const std::string& name) const {return entries.count(name) > 0;}
+  // Returns GLSL code declaring the block and a macro for each uniform. No
+  // more uniforms can be added afterwards.
+  std::string getCode();
+  std::shared_ptr<vkhlf::DescriptorSetLayout> getSetLayout() const {return setLayout;}
+  std::shared_ptr<vkhlf::DescriptorSet> getSet() const {return set;}
+
+  // Records an upload of current values, if they changed since the last
+  // upload or a new frame has begun. Must be recorded outside of a render
+  // pass, before any draw that uses the block.
+  void flush(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer);
+
+private:
+  struct Entry{
+    size_t offset;
+    DataType type;
+  };
+  std::map<std::string, Entry> entries;
+  // Declaration order, which is also the order within the block.
+  std::vector<std::string> order;
+  size_t timeOffset;
+
+  std::vector<char> values;
+  bool locked = false;
+  void lock();
+
+  bool dirty = true;
+  // The sync count at the time of the last upload.
+  uint64_t uploadFrame = 0;
+
+  std::shared_ptr<vkhlf::DescriptorSetLayout> setLayout;
+  std::shared_ptr<DescriptorAllocator> allocator;
+  std::shared_ptr<vkhlf::DescriptorSet> set;
+  std::shared_ptr<vkhlf::Buffer> buffer;
+};
+
+} // namespace sga
+
+#endif // __FRAME_HPP__
@@ -7,6 +7,11 @@
 
 namespace sga{
 
+class DescriptorAllocator;
+class FrameUniformBlock;
+class UniformRing;
+class StagingRing;
+
 // TODO: Instanceable?
 class global{
 public:
@@ -20,8 +25,26 @@ public:
   static std::shared_ptr<vkhlf::Device> device;
   //static std::shared_ptr<vkhlf::Queue> queue;
   static std::shared_ptr<vkhlf::CommandPool> commandPool;
+  // Shared source of descriptor sets which are only used within a single frame.
+  static std::shared_ptr<DescriptorAllocator> descriptorAllocator;
+  // Shared host-visible memory for image transfers.
+  static std::shared_ptr<StagingRing> stagingRing;
+  // Uniforms shared by all pipelines, see FrameUniforms.
+  static std::shared_ptr<FrameUniformBlock> frameUniforms;
+  // Per-frame uniform values of draws within chains.
+  static std::shared_ptr<UniformRing> uniformRing;
+  // Shared by all pipelines, so that identical shader stages and state are
+  // only compiled by the driver once.
+  static std::shared_ptr<vkhlf::PipelineCache> pipelineCache;
 
   static unsigned int queueFamilyIndex;
+  // Features enabled on the logical device, and limits of the physical device.
+  static vk::PhysicalDeviceFeatures deviceFeatures;
+  static vk::PhysicalDeviceLimits deviceLimits;
+  // Whether the device has a memory type for lazily allocated transient images.
+  static bool lazilyAllocatedMemory;
+  // Whether vertex shaders may write gl_Layer (VK_EXT_shader_viewport_index_layer).
+  static bool vertexShaderLayer;
   // We keep a reference to the debug report callback so that it stays alive with the instance!
   static std::shared_ptr<vkhlf::DebugReportCallback> debugReportCallback;
 };
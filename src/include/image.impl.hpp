@@ -4,6 +4,7 @@
 #include <sga/image.hpp>
 #include <sga/layout.hpp>
 #include <functional>
+#include <map>
 
 #include <vkhlf/vkhlf.h>
 
@@ -28,13 +29,22 @@ struct FormatProperties{
 };
 
 const FormatProperties& getFormatProperties(unsigned int channels, ImageFormat format);
+// Returns the GLSL layout qualifier for storage images of the given format.
+std::string getStorageFormatQualifier(unsigned int channels, ImageFormat format);
 
 class Image::Impl{
 public:
-  Impl(unsigned int width, unsigned int height, unsigned int channels, ImageFormat format, ImageFilterMode filtermode);
+  Impl(unsigned int width, unsigned int height, unsigned int channels, ImageFormat format, ImageFilterMode filtermode,
+       ImageType type = ImageType::Single, unsigned int layers = 1, ImageUsage usage = ImageUsage::Default);
   
   void putDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size);
   void getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size);
+  // Transfer a rectangle of each layer. Rows are row_pitch bytes apart in
+  // data, 0 means they are packed.
+  void putDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                  unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch);
+  void getDataRaw(unsigned char * data, size_t n, DataType dtype, size_t value_size,
+                  unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch);
 
   void loadPNG(std::string filepath);
   void loadPNGInternal(uint8_t* stbi_data);
@@ -42,6 +52,13 @@ public:
   
   void setClearColor(ImageClearColor cc);
   void clear();
+  // Performs the pending clear right away, if there is one. This must be
+  // called before any operation that reads the image contents.
+  void flushClear();
+  void clearNow();
+  // Rebuilds mipmaps if the base level changed since they were last built.
+  // This must be called before the image is sampled.
+  void flushMips();
   
   void copyOnto(
     std::shared_ptr<Image> target,
@@ -58,7 +75,9 @@ public:
   unsigned int getWidth() {return width;}
   unsigned int getHeight() {return height;}
   unsigned int getChannels() {return channels;}
-  unsigned int getValuesN() {return width * height * channels;}
+  unsigned int getLayers() {return layers;}
+  ImageType getType() {return type;}
+  unsigned int getValuesN() {return N_values();}
 
   void withLayout(vk::ImageLayout il, std::function<void()> f);
   
@@ -67,29 +86,63 @@ public:
   static std::unique_ptr<Image::Impl> createFromPNG(std::string png_path, ImageFormat format, ImageFilterMode filtermode);
   
   friend class Pipeline;
+  friend class ComputePipeline;
+  friend class PipelineChain;
   
 private:
   const unsigned int width, height;
   const unsigned int channels;
+  const ImageType type;
+  const unsigned int layers;
   ImageFormat userFormat;
   FormatProperties format;
   ImageFilterMode filtermode;
   ImageClearColor clearColor;
+  // True if the image was requested to be cleared, but no render pass or
+  // explicit clear did it yet.
+  bool pendingClear = false;
+  // Whether the image was created with storage usage.
+  bool supportsStorage = false;
+  // Whether the image was created with input attachment usage.
+  bool supportsInputAttachment = false;
+  bool isDepth() const {return userFormat == ImageFormat::Depth || userFormat == ImageFormat::Depth16;}
+  vk::ImageAspectFlags getAspect() const {
+    return isDepth() ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor;
+  }
   bool hasMipmaps(){
     return filtermode == ImageFilterMode::MipMapped || filtermode == ImageFilterMode::Anisotropic;
   }
 
-  // The number of pixels in this image.
-  unsigned int N_pixels() const {return width * height;}
+  // Validates a region of image data of n bytes, made of values of value_size
+  // bytes each, and returns its row pitch.
+  size_t checkRegion(size_t n, size_t value_size, unsigned int x, unsigned int y, unsigned int w, unsigned int h, size_t row_pitch) const;
+
+  // The number of pixels in this image, in all layers.
+  unsigned int N_pixels() const {return width * height * layers;}
   // The number of values in this image. 
-  unsigned int N_values() const {return width * height * channels;}
+  unsigned int N_values() const {return width * height * layers * channels;}
+  // The base mip level of all layers.
+  vk::ImageSubresourceRange getBaseRange() const {return {getAspect(), 0, 1, 0, layers};}
   
   vk::ImageLayout current_layout;
   
   std::shared_ptr<vkhlf::Image> image;
   std::shared_ptr<vkhlf::ImageView> image_view;
   void prepareImage();
-
+  /* Framebuffer attachments must be views of a single mip level. The same view
+   * is used when the image is read as an input attachment. */
+  std::shared_ptr<vkhlf::ImageView> attachment_view;
+  std::shared_ptr<vkhlf::ImageView> getAttachmentView();
+  /* Render targets of layered images are views of either a single layer, or
+   * of all layers as a 2D array (for a negative layer). */
+  std::map<int, std::shared_ptr<vkhlf::ImageView>> target_views;
+  std::shared_ptr<vkhlf::ImageView> getTargetView(int layer);
+
+  /* Mipmaps are rebuilt lazily, as each regeneration is a synchronous submit
+   * blitting the whole chain. Modifications of the base level only mark them
+   * as outdated, so e.g. many draws onto a target cost a single rebuild. */
+  bool mipsDirty = false;
+  void invalidateMips() {if(hasMipmaps()) mipsDirty = true;}
   void regenerateMips();
   unsigned int getDesiredMipsNo() const;
 };
@@ -10,6 +10,9 @@ unsigned int getDataTypeSize(DataType dt);
 unsigned int getDataTypeGLSLstd140Alignment(DataType dt);
 size_t getAnnotatedDataLayoutSize(const std::vector<std::pair<DataType, std::string>>&);
 size_t getAnnotatedDataLayoutUBOSize(const std::vector<std::pair<DataType, std::string>>&);
+// Computes member offsets of array elements of the given layout in std430,
+// and returns the array stride.
+size_t getDataLayoutStd430Offsets(const DataLayout& layout, std::vector<size_t>& offsets);
 } // namespace sga
 
 #endif // __LAYOUT_HPP__
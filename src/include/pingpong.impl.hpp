@@ -0,0 +1,33 @@
+#ifndef __PINGPONG_IMPL_HPP__
+#define __PINGPONG_IMPL_HPP__
+
+#include <sga/pingpong.hpp>
+
+#include <vector>
+
+namespace sga{
+
+class PingPong::Impl{
+public:
+  Impl(int width, int height, unsigned int channels, ImageFormat format);
+
+  void setProgram(const Program& program, std::string samplerName,
+                  SamplerInterpolation interpolation, SamplerWarpMode warp_mode);
+  void setSampler(std::string name, const Image& image,
+                  SamplerInterpolation interpolation, SamplerWarpMode warp_mode);
+  void iterate(unsigned int n);
+  Image& getCurrent() {return images[current];}
+
+  friend class PingPong;
+private:
+  // Pipeline i samples images[i] and renders onto the other image. Each keeps
+  // its configuration, so that swapping roles requires no reconfiguration.
+  std::vector<Image> images;
+  FullQuadPipeline pipelines[2];
+  unsigned int current = 0;
+  bool programSet = false;
+};
+
+} // namespace sga
+
+#endif // __PINGPONG_IMPL_HPP__
@@ -8,8 +8,15 @@
 #include <sga/vbo.hpp>
 #include <sga/shader.hpp>
 #include <sga/image.hpp>
+#include <sga/query.hpp>
+#include <sga/chain.hpp>
+
+#include "bundle.impl.hpp"
+#include "shader.impl.hpp"
 
 #include <unordered_set>
+#include <map>
+#include <tuple>
 
 namespace sga{
 
@@ -19,22 +26,33 @@ public:
   virtual ~Impl();
   void setTarget(const Window& tgt);
   void setTarget(std::vector<Image> images);
+  void setTargetLayer(unsigned int layer);
+  void setTargetAllLayers();
   
   void draw(const VBO&);
   void drawIndexed(const VBO&, const IBO& ibo);
+  void drawProcedural(unsigned int n);
   void drawBuffer(std::shared_ptr<vkhlf::Buffer>, unsigned int n,
                   std::shared_ptr<vkhlf::Buffer> = nullptr, unsigned int = 0);
   void clear();
   
   virtual void setProgram(const Program&);
 
-  void setUniform(std::string name, std::initializer_list<float> floats);  
-  void setUniform(DataType dt, std::string name, char* pData, size_t size, bool standard=false);
+  void setUniform(const std::string& name, std::initializer_list<float> floats);
+  void setUniform(DataType dt, const std::string& name, char* pData, size_t size);
+  void setUniform(DataType dt, const void* handleProgram, size_t offset, DataType handleType, unsigned int index, char* pData, size_t size);
+  void getUniformHandle(const std::string& name, const void*& program, size_t& offset, DataType& type, unsigned int& index);
+  // Computes standard uniforms for the next draw.
   void updateStandardUniforms();
 
   void setSampler(std::string, const Image&,
                   SamplerInterpolation intefrpolation = SamplerInterpolation::Linear,
                   SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+  void setSampler(std::string, unsigned int index, const Image&,
+                  SamplerInterpolation intefrpolation = SamplerInterpolation::Linear,
+                  SamplerWarpMode warp_mode = SamplerWarpMode::Clamp);
+  void setStorageBuffer(std::string, const StorageBuffer&);
+  void setInputAttachment(std::string, const Image&);
   
   void setFaceCull(FaceCullMode fcm = FaceCullMode::None, FaceDirection fd = FaceDirection::Clockwise);
   void setPolygonMode(PolygonMode p);
@@ -43,16 +61,48 @@ public:
 
   void setBlendModeColor(BlendFactor src, BlendFactor dst, BlendOperation op);
   void setBlendModeAlpha(BlendFactor src, BlendFactor dst, BlendOperation op);
+
+  void setDepthTest(bool enabled);
+  void setDepthWrite(bool enabled);
+  void setDepthCompare(CompareOp op);
+  void setDepthFormat(DepthFormat format);
+  void setDepthClearValue(float value);
+  void setReverseZ(bool enabled);
+
+  void setTargetUsageHint(TargetUsageHint hint);
+  void setDepthUsageHint(TargetUsageHint hint);
+
+  void setMultisampling(unsigned int samples);
+
+  void setOcclusionQuery(std::shared_ptr<OcclusionQuery::Impl> query);
+  void setDrawCondition(std::shared_ptr<OcclusionQuery::Impl> query);
   
   void resetViewport();
   void setViewport(float left, float top, float right, float bottom);
   
   bool ensureValidity();
+
+  // Records a draw with the current configuration into a bundle segment.
+  void recordDraw(Bundle::Impl::Segment& segment, const VBO& vbo, const IBO* ibo);
+
+  friend class Bundle;
+  friend class PipelineChain;
 protected:
+  /* Validation results are cached, as the checks only depend on pipeline
+   * configuration. `validated` covers the program and targets, while
+   * `bindings_validated` covers samplers and uniforms bound to the program. */
+  bool validated = false;
+  void ensureBindingsValidity();
+
   bool target_is_window;
   std::shared_ptr<Window::Impl> targetWindow;
   std::vector<std::shared_ptr<Image::Impl>> targetImages;
+  // A user-provided depth image, if there is one.
   std::shared_ptr<Image::Impl> depthTarget;
+  // The image that determines the size of image targets.
+  std::shared_ptr<Image::Impl> getTargetSizeImage() const {
+    return targetImages.empty() ? depthTarget : targetImages[0];
+  }
 
   std::shared_ptr<Program::Impl> program;
   
@@ -68,65 +118,325 @@ protected:
   BlendFactor blendFactorAlphaDst = BlendFactor::Zero;
   BlendOperation blendOperationColor = BlendOperation::Add;
   BlendOperation blendOperationAlpha = BlendOperation::Add;
+
+  bool depthTest = true;
+  bool depthWrite = true;
+  CompareOp depthCompare = CompareOp::LessOrEqual;
+  // Properties of the internal depth buffer.
+  vk::Format depthFormat = vk::Format::eD32Sfloat;
+  float depthClearValue = 1.0f;
+  // The format of the depth attachment, either a depth target or internal.
+  vk::Format getDepthFormat() const;
+
+  // The layer of layered targets rendered onto, or -1 for all of them.
+  int targetLayer = -1;
+
+  TargetUsageHint targetUsageHint = TargetUsageHint::Default;
+  TargetUsageHint depthUsageHint = TargetUsageHint::Default;
+  // Only the internal depth buffer may be discarded.
+  bool depthDiscarded() const {
+    return !depthTarget && depthUsageHint == TargetUsageHint::Discard;
+  }
+
+  // Samples per pixel used for image targets.
+  vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+
+  // Counts samples passed in draws, if set.
+  std::shared_ptr<OcclusionQuery::Impl> occlusionQuery;
+  // Draws are skipped if this query reports nothing was visible.
+  std::shared_ptr<OcclusionQuery::Impl> drawCondition;
   
+  // Pushed with each draw.
+  StandardConstants standardConstants;
+
   bool vp_set = false;
   float vp_top = 0.0f, vp_bottom = 0.0f, vp_left = 0.0f, vp_right = 0.0f;
   // If vp_set is false, this function sets vp_* according to target size.
   void prepareVp(); 
   
-  void clearDepthImage();
-  
+  /* Everything needed to begin a render pass onto current targets. Preparing
+   * it switches layouts of targets, and takes over their pending clears. */
+  struct TargetPass{
+    std::shared_ptr<vkhlf::RenderPass> renderPass;
+    std::shared_ptr<vkhlf::Framebuffer> framebuffer;
+    vk::Extent2D extent;
+    std::vector<vk::ClearValue> clearValues;
+  };
+  TargetPass prepareTargetPass();
+  // Marks targets as modified by a render pass.
+  void finishTargetPass();
+
+  /* Everything a draw records within a render pass. Values are copied, so
+   * that draws of a chain can be recorded once the chain ends. */
+  struct DrawCommands{
+    std::shared_ptr<vkhlf::Pipeline> pipeline;
+    std::shared_ptr<vkhlf::PipelineLayout> layout;
+    std::shared_ptr<vkhlf::DescriptorSet> descriptorSet;
+    StandardConstants constants;
+    vk::Viewport viewport;
+    vk::Rect2D area;
+    std::shared_ptr<vkhlf::Buffer> buffer, indices;
+    unsigned int n, indices_n;
+    std::shared_ptr<OcclusionQuery::Impl> query;
+    uint32_t querySlot = 0;
+
+    void record(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer) const;
+  };
+  DrawCommands prepareDrawCommands(std::shared_ptr<vkhlf::Buffer> buffer, unsigned int n,
+                                   std::shared_ptr<vkhlf::Buffer> indices, unsigned int indices_n);
+
+  /* A pipeline belongs to at most one chain. While the chain records, draws
+   * of this pipeline are deferred to its subpass of the chain's render pass,
+   * and vkPipelines are built for that subpass. */
+  PipelineChain::Impl* chain = nullptr;
+  unsigned int chainSubpass = 0;
+  // Whether this pipeline drew since the chain began recording.
+  bool chainDrawn = false;
+  bool isChainRecording() const;
+  std::shared_ptr<vkhlf::RenderPass> c_chainRenderPass;
+  // Makes images bound to samplers ready for sampling.
+  void prepareSampledImages();
+  // Whether the current program accesses storage buffers or images, and
+  // whether it may write them. Draws and dispatches of such programs are
+  // ordered with Utils::recordShaderStorageBarrier.
+  bool hasShaderStorage() const {
+    return !ps->s_storageBuffers.empty() || !ps->s_storageImages.empty();
+  }
+  bool writesShaderStorage() const {
+    return program->c_writesStorage;
+  }
+
   void cook();
   bool cooked = false;
   // These fields require cooking
   std::shared_ptr<vkhlf::Pipeline> c_pipeline;
   std::shared_ptr<vkhlf::RenderPass> c_renderPass;
-  std::shared_ptr<vkhlf::PipelineLayout> c_pipelineLayout;
 
-  void prepare_descset();
-  bool descset_prepared = false;
-  std::shared_ptr<vkhlf::DescriptorSet> d_descriptorSet;
-  std::shared_ptr<vkhlf::DescriptorSetLayout> d_descriptorSetLayout;
-  
-  void prepare_unibuffers();
-  bool unibuffers_prepared = false;
-  /* This bufer is permanently present on the device and contains current values
-   * (device-time). Draw commands update it by copying from the right clone of a
-   * staging buffer. */
-  std::shared_ptr<vkhlf::Buffer> b_uniformDeviceBuffer;
-  size_t b_uniformSize;
-  /* This buffer is in host memory. It is used for building the buffer as values
-   * are set with the API (host-time). On draw, the contents are copied to a
-   * staging buffer, which keeps this data until the frame is drawn by the
-   * device. This means there may simultaneously exist multiple staging buffers
-   * with different values, waiting to be used for rendering. */
-  char* b_uniformHostBuffer = nullptr;
-  /* Stores the names of uniforms that were set at least once. This is used for
-     ensuring that the user did not forget to set any uniform. */
-  std::unordered_set<std::string> uniformsSet;
+  /* All fixed-function state baked into a vkPipeline. Pipelines built for
+   * previously used states are kept, so that switching back and forth between
+   * a few configurations (e.g. toggling face culling or blending every frame)
+   * only costs a map lookup. The cache is kept separately for each program
+   * and render pass. */
+  struct StateKey{
+    FaceCullMode faceCullMode;
+    FaceDirection faceDirection;
+    PolygonMode polygonMode;
+    RasterizerMode rasterizerMode;
+    float line_width;
+    BlendFactor blendFactorColorSrc, blendFactorColorDst, blendFactorAlphaSrc, blendFactorAlphaDst;
+    BlendOperation blendOperationColor, blendOperationAlpha;
+    bool depthTest, depthWrite;
+    CompareOp depthCompare;
+
+    auto tie() const {
+      return std::tie(faceCullMode, faceDirection, polygonMode, rasterizerMode, line_width,
+                      blendFactorColorSrc, blendFactorColorDst, blendFactorAlphaSrc, blendFactorAlphaDst,
+                      blendOperationColor, blendOperationAlpha, depthTest, depthWrite, depthCompare);
+    }
+    bool operator<(const StateKey& other) const {return tie() < other.tie();}
+  };
+  StateKey getStateKey() const;
+  std::shared_ptr<vkhlf::Pipeline> createVkPipeline();
+  // Drops pipelines built for a render pass by all programs.
+  void clearPipelineVariants(std::shared_ptr<vkhlf::RenderPass> rp);
 
-  void prepare_samplers();
-  bool samplers_prepared = false;
   struct SamplerData{
     SamplerData() {}
-    SamplerData(int b) : bindno(b) {}
+    SamplerData(int b, unsigned int arraySize, bool shadow, ImageType type) : bindno(b), arraySize(arraySize), shadow(shadow), type(type), elements(std::max(1u, arraySize)) {}
     int bindno;
-    mutable std::shared_ptr<Image::Impl> image;
-    mutable std::shared_ptr<vkhlf::Sampler> sampler;
+    // 0 if this is not a sampler array.
+    unsigned int arraySize;
+    // Shadow samplers compare depth, and must be bound to depth images.
+    bool shadow;
+    // Bound images must be of this type.
+    ImageType type;
+    struct Element{
+      std::shared_ptr<Image::Impl> image;
+      std::shared_ptr<vkhlf::Sampler> sampler;
+    };
+    // Sampler arrays may have some elements not bound to any image, these are
+    // filled with any bound element when writing descriptors.
+    std::vector<Element> elements;
     
     bool operator<(const SamplerData& other) {return bindno < other.bindno;}
   };
-  // TODO: This keeps a OWNED reference to Image. This way we are sure the image
-  // is never destroyed as long as it is bound to some pipeline. However, how
-  // should a pipeline react on image changes (e.g. resizing?);
-  std::map<std::string, SamplerData> s_samplers;
+
+  struct StorageImageData{
+    unsigned int bindno;
+    std::shared_ptr<Image::Impl> image;
+  };
+  struct StorageBufferData{
+    unsigned int bindno;
+    DataLayout layout;
+    std::shared_ptr<StorageBuffer::Impl> buffer;
+  };
+  struct InputAttachmentData{
+    unsigned int bindno;
+    unsigned int index;
+    std::shared_ptr<Image::Impl> image;
+  };
+
+  /* Everything that depends on the program. Each program set on this pipeline
+   * keeps its own state, so switching back to a previously used program
+   * restores its uniform values, sampler bindings, descriptor set and cooked
+   * vkPipelines instead of preparing them again. Layouts are shared by all
+   * pipelines using a program, and are kept by the program itself. States do
+   * not keep their programs alive, the state of a program is dropped once the
+   * program is destroyed. */
+  struct ProgramState{
+    ProgramState() {}
+    ProgramState(const ProgramState&) = delete;
+    ProgramState& operator=(const ProgramState&) = delete;
+    ~ProgramState() {delete[] b_uniformHostBuffer;}
+
+    std::weak_ptr<Program::Impl> program;
+
+    // See `validated`.
+    bool bindings_validated = false;
+
+    // Built vkPipelines, for each compatible render pass they were used with.
+    std::map<std::shared_ptr<vkhlf::RenderPass>,
+             std::map<StateKey, std::shared_ptr<vkhlf::Pipeline>>> c_pipelineVariants;
+
+    /* Descriptor sets are taken from the global per-frame allocator. A set is
+     * never modified once written, because previously recorded draws may still
+     * use it. Instead, whenever bindings change (or the frame the set was
+     * allocated in retires), a fresh set is acquired before the next draw. */
+    std::shared_ptr<vkhlf::DescriptorSet> d_descriptorSet;
+    uint64_t d_descriptorSetFrame = 0;
+    bool d_descriptorSetDirty = true;
+
+    bool unibuffers_prepared = false;
+    /* This bufer is permanently present on the device and contains current values
+     * (device-time). Draw commands update it with an update recorded right
+     * before their render pass, so each draw sees the values set before it. */
+    std::shared_ptr<vkhlf::Buffer> b_uniformDeviceBuffer;
+    size_t b_uniformSize;
+    /* This buffer is in host memory. It is used for building the buffer as values
+     * are set with the API (host-time). On draw, the range of it modified since
+     * the previous draw is uploaded to the device buffer. Draws that follow a
+     * draw with the same values upload nothing. */
+    char* b_uniformHostBuffer = nullptr;
+    size_t b_dirtyBegin = 0, b_dirtyEnd = 0;
+    /* Set when the current descriptor set refers to a slice of the uniform
+     * ring instead of the device buffer, which then lacks some values. */
+    bool b_uniformsInRing = false;
+    void markDirty(size_t offset, size_t size){
+      if(b_dirtyBegin == b_dirtyEnd){
+        b_dirtyBegin = offset;
+        b_dirtyEnd = offset + size;
+      }else{
+        b_dirtyBegin = std::min(b_dirtyBegin, offset);
+        b_dirtyEnd = std::max(b_dirtyEnd, offset + size);
+      }
+    }
+    /* Marks uniforms (by their index) that were set at least once. This is used
+       for ensuring that the user did not forget to set any uniform. */
+    std::vector<bool> uniformsSet;
+    unsigned int uniformsSetCount = 0;
+
+    bool samplers_prepared = false;
+    // TODO: This keeps a OWNED reference to Image. This way we are sure the image
+    // is never destroyed as long as it is bound to some pipeline. However, how
+    // should a pipeline react on image changes (e.g. resizing?);
+    std::map<std::string, SamplerData> s_samplers;
+    // Storage images of compute programs, prepared along with samplers.
+    std::map<std::string, StorageImageData> s_storageImages;
+    std::map<std::string, StorageBufferData> s_storageBuffers;
+    std::map<std::string, InputAttachmentData> s_inputAttachments;
+
+    // Compute programs have a single vkPipeline.
+    std::shared_ptr<vkhlf::Pipeline> c_computePipeline;
+  };
+  std::map<const Program::Impl*, ProgramState> programStates;
+  // The state of the current program.
+  ProgramState* ps = nullptr;
+  // Makes the state of the given program current, creating it if needed.
+  void switchProgramState(std::shared_ptr<Program::Impl> p);
+
+  void acquire_descset();
+  // Acquires a fresh descriptor set referring to a copy of current uniform
+  // values in the uniform ring.
+  void acquire_ring_descset();
+  void write_descset(std::shared_ptr<vkhlf::DescriptorSet> set, std::shared_ptr<vkhlf::Buffer> uniformBuffer,
+                     vk::DeviceSize uniformOffset = 0);
+  void prepare_unibuffers();
+  std::shared_ptr<vkhlf::Buffer> createUniformBuffer() const;
+  // Records an upload of uniform values modified since the previous draw or
+  // dispatch to the device buffer.
+  void recordUniformUpload(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer);
+  void markUniformSet(unsigned int index);
+  void prepare_samplers();
 
   void prepare_renderpass();
   bool renderpass_prepared;
+  /* Creates a render pass for current image targets. Attachments whose bits
+   * are set in clearMask (bit i for i-th target, bit N for depth) are cleared
+   * on load, others are loaded. All such render passes are compatible. */
+  std::shared_ptr<vkhlf::RenderPass> createRenderPass(uint32_t clearMask);
+  std::shared_ptr<vkhlf::RenderPass> getRenderPassVariant(uint32_t clearMask);
+  /* Render passes are cached by everything that affects them, so they
+   * survive target changes. As long as attachment formats stay the same, the
+   * pipelines built for a cached render pass can be reused as well. */
+  struct RenderPassKey{
+    std::vector<vk::Format> colorFormats;
+    vk::Format depthFormat;
+    vk::SampleCountFlagBits samples;
+    TargetUsageHint targetUsageHint;
+    bool depthDiscarded;
+    uint32_t clearMask;
+
+    auto tie() const {
+      return std::tie(colorFormats, depthFormat, samples, targetUsageHint, depthDiscarded, clearMask);
+    }
+    bool operator<(const RenderPassKey& other) const {return tie() < other.tie();}
+  };
+  std::map<RenderPassKey, std::shared_ptr<vkhlf::RenderPass>> rp_renderpassVariants;
+  // Deferred clear of the depth image, performed by the next render pass.
+  bool rp_depthPendingClear = false;
+  /* When multisampling, color attachments are these images, and target
+   * images are resolve attachments which follow the depth attachment. Newly
+   * created images are cleared by the next render pass. */
+  std::vector<std::shared_ptr<vkhlf::Image>> rp_msColorImages;
+  bool rp_msPendingClear = false;
   std::shared_ptr<vkhlf::RenderPass> rp_renderpass;
   std::shared_ptr<vkhlf::Framebuffer> rp_framebuffer;
   std::shared_ptr<vkhlf::Image> rp_depthimage;
   vk::Extent2D rp_image_target_extent;
+  // The number of layers of the framebuffer.
+  uint32_t rp_image_target_layers = 1;
+  /* The internal depth image and multisampled images do not depend on which
+   * images are targets, so they are only recreated when any of these
+   * properties changes. */
+  void prepare_internal_attachments();
+  struct InternalAttachmentsKey{
+    std::vector<vk::Format> colorFormats;
+    vk::Format depthFormat;
+    vk::SampleCountFlagBits samples;
+    bool msTransient, depthTransient, hasDepthTarget;
+    uint32_t width, height, layers;
+
+    auto tie() const {
+      return std::tie(colorFormats, depthFormat, samples, msTransient, depthTransient, hasDepthTarget, width, height, layers);
+    }
+    bool operator==(const InternalAttachmentsKey& other) const {return tie() == other.tie();}
+  };
+  InternalAttachmentsKey rp_internalKey;
+  bool rp_internalPrepared = false;
+  std::vector<std::shared_ptr<vkhlf::ImageView>> rp_msColorViews;
+  std::shared_ptr<vkhlf::ImageView> rp_depthview;
+  /* Framebuffers for previously used sets of target images and target layers,
+   * so that alternating between targets does not recreate them. Entries are
+   * dropped once any of their images is destroyed, and all of them when
+   * internal attachments are recreated. */
+  struct FramebufferData{
+    std::vector<std::weak_ptr<Image::Impl>> images;
+    std::shared_ptr<vkhlf::Framebuffer> framebuffer;
+  };
+  std::map<std::pair<std::vector<const Image::Impl*>, int>, FramebufferData> rp_framebuffers;
+  // Window render passes change when window settings do, pipelines built for
+  // a previous one are dropped.
+  std::shared_ptr<vkhlf::RenderPass> c_windowRenderPass;
 };
 
 class FullQuadPipeline::Impl : public Pipeline::Impl{
@@ -137,6 +447,7 @@ public:
   
   void setProgram(const Program&) override;
 
+  friend class Bundle;
 protected:
   VBO vbo;
 };
@@ -0,0 +1,50 @@
+#ifndef __QUERY_IMPL_HPP__
+#define __QUERY_IMPL_HPP__
+
+#include <sga/query.hpp>
+
+#include <vkhlf/vkhlf.h>
+
+#include <deque>
+
+namespace sga{
+
+class OcclusionQuery::Impl{
+public:
+  Impl();
+
+  bool isResultAvailable();
+  uint64_t getSamplesPassed();
+  bool isVisible();
+
+  // Records the beginning of a query into a render pass. The query pool slot
+  // used is reset beforehand, so this must be called outside of it.
+  uint32_t prepareSlot(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer);
+  void begin(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer, uint32_t slot);
+  void end(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer, uint32_t slot);
+
+private:
+  // Reads results of finished draws.
+  void poll();
+
+  // The number of draws that can await their results at the same time.
+  static const uint32_t slotCount = 4;
+  std::shared_ptr<vkhlf::QueryPool> pool;
+  uint32_t nextSlot = 0;
+  /* Slots used by recorded draws, oldest first, together with the sync count
+   * at the time they were recorded. A slot's result is only read once the
+   * commands using it are known to be finished, otherwise a stale result
+   * from before its reset could be read. */
+  struct Pending{
+    uint32_t slot;
+    uint64_t syncCount;
+  };
+  std::deque<Pending> pending;
+
+  bool resultAvailable = false;
+  uint64_t samplesPassed = 0;
+};
+
+} // namespace sga
+
+#endif // __QUERY_IMPL_HPP__
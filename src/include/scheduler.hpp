@@ -39,6 +39,11 @@ public:
 
   // Waits until all scheduled actions are finished.
   static void sync();
+
+  // Returns the number of syncs performed so far. Resources used only by
+  // chained commands recorded while this value was N are guaranteed to be no
+  // longer in use by the GPU once it becomes greater than N.
+  static uint64_t getSyncCount() {return sync_count;}
   
 private:
   static void finalizeChainedCmdBuffer();
@@ -55,6 +60,8 @@ private:
   static std::shared_ptr<vkhlf::Semaphore> last_chain_semaphore;
 
   static std::shared_ptr<vkhlf::CommandBuffer> current_command_buffer;
+
+  static uint64_t sync_count;
 };
 
 } // namespace sga
@@ -7,6 +7,10 @@
 
 #include <sga/layout.hpp>
 
+#include <set>
+#include <array>
+#include <functional>
+
 namespace sga{
 
 struct AttrParams{
@@ -15,6 +19,34 @@ struct AttrParams{
   std::string out_smoothness_qualifier;
 };
 
+struct SamplerParams{
+  std::string name;
+  // Number of elements for sampler arrays, 0 for a single sampler.
+  unsigned int arraySize;
+  // Whether this is a depth comparison sampler.
+  bool shadow = false;
+  ImageType type = ImageType::Single;
+};
+
+struct StorageImageParams{
+  std::string name;
+  unsigned int channels;
+  ImageFormat format;
+};
+
+struct InputAttachmentParams{
+  std::string name;
+  ImageFormat format;
+};
+
+struct StorageBufferParams{
+  std::string name;
+  // Fields of each element. A single unnamed field means elements are
+  // values of that type rather than structs.
+  std::vector<std::pair<DataType, std::string>> fields;
+  bool readOnly;
+};
+
 class Shader::Impl{
 public:
   Impl();
@@ -29,15 +61,30 @@ public:
   void addOutput(std::pair<DataType, std::string>);
   void addOutput(std::initializer_list<std::pair<DataType, std::string>>);
   
-  void addUniform(DataType type, std::string name, bool special = false);
-  void addSampler(std::string name);
+  void addUniform(DataType type, std::string name);
+  void addSampler(std::string name, ImageType type);
+  void addSamplerArray(std::string name, unsigned int size);
+  void addShadowSampler(std::string name, ImageType type);
+  void addStorageImage(std::string name, unsigned int channels, ImageFormat format);
+  void addStorageBuffer(std::string name, std::vector<std::pair<DataType, std::string>> fields, bool readOnly);
+  void addInputAttachment(std::string name, ImageFormat format);
   
+  void setWorkGroupSize(unsigned int x, unsigned int y, unsigned int z);
   void setOutputInterpolationMode(std::string name, OutputInterpolationMode mode);
   
   std::vector<AttrParams> inputAttr, outputAttr, uniforms;
-  std::vector<std::string> samplers;
+  std::vector<SamplerParams> samplers;
+  std::vector<StorageImageParams> storageImages;
+  std::vector<StorageBufferParams> storageBuffers;
+  std::vector<InputAttachmentParams> inputAttachments;
+  std::array<unsigned int, 3> workGroupSize = {{1, 1, 1}};
+};
 
-  void addStandardUniforms();
+// Standard uniforms that depend on the target, passed as push constants. The
+// layout matches the sga_standard block of shaders.
+struct StandardConstants{
+  float viewport[4];
+  float resolution[2];
 };
 
 class Program::Impl{
@@ -45,38 +92,94 @@ public:
   Impl();
   void setVertexShader(VertexShader vs);
   void setFragmentShader(FragmentShader vs);
+  void setComputeShader(ComputeShader cs);
   
   void compile();
   void compileFullQuad();
   void compile_internal();
+  void prepareLayouts();
   
   friend class Pipeline;
   friend class FullQuadPipeline;
+  friend class ComputePipeline;
 private:
   struct ShaderData{
     std::string autoSource, source, attrCode, fullSource;
     std::vector<AttrParams> inputAttr, outputAttr, uniforms;
-    std::vector<std::string> samplers;
+    std::vector<SamplerParams> samplers;
+    std::vector<StorageImageParams> storageImages;
+    std::vector<StorageBufferParams> storageBuffers;
+    std::vector<InputAttachmentParams> inputAttachments;
     DataLayout inputLayout, outputLayout;
   };
   ShaderData VS;
   ShaderData FS;
+  ShaderData CS;
+  std::array<unsigned int, 3> workGroupSize;
+  // The shaders of this program, in the order they are processed.
+  std::vector<std::reference_wrapper<ShaderData>> getStages();
   
   std::string prepareErrorDescrip(std::string infoLog, const ShaderData& sd) const;
 
   bool compiled = false;
   bool isFullQuad = false;
+  bool isCompute = false;
   
   // Only valid once compiled.
   DataLayout c_inputLayout;
   DataLayout c_outputLayout;
   std::shared_ptr<vkhlf::ShaderModule> c_VS_shader = nullptr;
   std::shared_ptr<vkhlf::ShaderModule> c_FS_shader = nullptr;
+  std::shared_ptr<vkhlf::ShaderModule> c_CS_shader = nullptr;
+  // Stages that access descriptors.
+  vk::ShaderStageFlags c_stages;
 
-  std::map<std::string, std::pair<size_t, DataType>> c_uniformOffsets;
+  struct UniformData{
+    size_t offset;
+    DataType type;
+    // Uniforms are numbered consecutively in name order.
+    unsigned int index;
+  };
+  std::map<std::string, UniformData> c_uniforms;
   size_t c_uniformSize = 0;
   
   std::map<std::string, unsigned int> c_samplerBindings;
+  // Array size for each sampler, 0 if the sampler is not an array.
+  std::map<std::string, unsigned int> c_samplerArraySizes;
+  // Samplers which perform depth comparison.
+  std::set<std::string> c_shadowSamplers;
+  // The type of images each sampler reads.
+  std::map<std::string, ImageType> c_samplerTypes;
+
+  struct StorageImageData{
+    unsigned int bindno;
+    unsigned int channels;
+    ImageFormat format;
+  };
+  std::map<std::string, StorageImageData> c_storageImages;
+
+  struct StorageBufferData{
+    unsigned int bindno;
+    DataLayout layout;
+  };
+  std::map<std::string, StorageBufferData> c_storageBuffers;
+  // Whether any shader may write storage buffers or images.
+  bool c_writesStorage = false;
+
+  struct InputAttachmentData{
+    unsigned int bindno;
+    // The input_attachment_index, i.e. the declaration order.
+    unsigned int index;
+    ImageFormat format;
+  };
+  std::map<std::string, InputAttachmentData> c_inputAttachments;
+
+  /* Layouts are built once per program and shared by all pipelines using it,
+   * which keeps these pipelines layout-compatible. */
+  std::shared_ptr<vkhlf::DescriptorSetLayout> c_descriptorSetLayout;
+  // Number of descriptors of each type a set for this program requires.
+  std::map<vk::DescriptorType, unsigned int> c_descriptorRequirements;
+  std::shared_ptr<vkhlf::PipelineLayout> c_pipelineLayout;
 };
 
 std::vector<uint32_t> compileGLSLToSPIRV(vk::ShaderStageFlagBits stage, std::string const & source);
@@ -0,0 +1,49 @@
+#ifndef __STAGING_HPP__
+#define __STAGING_HPP__
+
+#include <vkhlf/vkhlf.h>
+
+namespace sga{
+
+/* Hands out regions of a single, persistently mapped, host-visible buffer for
+ * transfers between host memory and images, instead of creating a staging
+ * resource for each transfer.
+ *
+ * Regions are allocated one after another, and may be used by commands
+ * recorded during the current frame, i.e. until the next Scheduler sync. Once
+ * the frame retires, the GPU no longer uses any of them, so the ring wraps
+ * around to the beginning. If a frame needs more space than is left, the ring
+ * syncs early. Memory is host-coherent, so it needs no flushes. */
+class StagingRing{
+public:
+  StagingRing();
+  ~StagingRing();
+
+  struct Region{
+    std::shared_ptr<vkhlf::Buffer> buffer;
+    vk::DeviceSize offset;
+    // Points to the mapped memory of this region.
+    uint8_t* data;
+  };
+  // The offset of the returned region is suitably aligned for copies of any
+  // image format.
+  Region allocate(vk::DeviceSize size);
+
+  vk::DeviceSize getCapacity() const {return capacity;}
+
+private:
+  // Replaces the ring with a larger buffer. The previous one stays alive
+  // until the current frame retires.
+  void grow(vk::DeviceSize size);
+  // Creates a mapped host-visible buffer.
+  static Region createBuffer(vk::DeviceSize size);
+
+  Region ring;
+  vk::DeviceSize capacity = 0;
+  vk::DeviceSize head = 0;
+  uint64_t frame = 0;
+};
+
+} // namespace sga
+
+#endif // __STAGING_HPP__
@@ -0,0 +1,58 @@
+#ifndef __UNIFORMRING_HPP__
+#define __UNIFORMRING_HPP__
+
+#include <vkhlf/vkhlf.h>
+
+#include <vector>
+
+namespace sga{
+
+/* Hands out slices of a single, persistently mapped, host-visible uniform
+ * buffer, for uniform values that must stay unchanged until commands recorded
+ * only later read them.
+ *
+ * Slices are allocated one after another, and stay valid during the current
+ * frame. As with a per-frame DescriptorAllocator, the frame does not retire on
+ * syncs while the ring is held. Once it retires, the ring wraps around to the
+ * beginning. If a frame needs more space than is left, the ring is replaced
+ * with a larger buffer. Memory is host-coherent, so it needs no flushes. */
+class UniformRing{
+public:
+  UniformRing();
+  ~UniformRing();
+
+  struct Slice{
+    std::shared_ptr<vkhlf::Buffer> buffer;
+    vk::DeviceSize offset;
+    // Points to the mapped memory of this slice.
+    uint8_t* data;
+  };
+  // The offset of the returned slice is suitably aligned for binding it as a
+  // uniform buffer.
+  Slice allocate(vk::DeviceSize size);
+
+  void hold() {holds++;}
+  void release();
+
+  vk::DeviceSize getCapacity() const {return capacity;}
+
+private:
+  // Replaces the ring with a buffer large enough for the given size. The
+  // previous one stays alive until the current frame retires.
+  void grow(vk::DeviceSize size);
+  // Wraps the ring around, if the frame it was used by has retired.
+  void retireFrameIfNeeded();
+
+  std::shared_ptr<vkhlf::Buffer> buffer;
+  uint8_t* data = nullptr;
+  vk::DeviceSize capacity = 0;
+  vk::DeviceSize head = 0;
+  uint64_t frame = 0;
+  unsigned int holds = 0;
+  // Buffers replaced during the current frame.
+  std::vector<std::shared_ptr<vkhlf::Buffer>> replaced;
+};
+
+} // namespace sga
+
+#endif // __UNIFORMRING_HPP__
@@ -28,7 +28,28 @@ std::vector<std::string> SplitString(std::string str, std::string delimiter, boo
 class Utils{
 public:
   static vk::ClearColorValue imageClearColorToVkClearColorValue(ImageClearColor cc);
+  static vk::ClearDepthStencilValue imageClearColorToVkClearDepthStencilValue(ImageClearColor cc);
   static std::string readEntireFile(std::string path);
+  // Converts a number of samples per pixel to a sample count flag, ensuring
+  // the device can render to color and depth attachments with that many.
+  static vk::SampleCountFlagBits getSampleCountFlag(unsigned int samples);
+  // Converts a depth format to a Vulkan format, ensuring the device can use it
+  // for depth attachments.
+  static vk::Format getDepthFormat(DepthFormat df);
+  static void ensureDepthFormatSupport(vk::Format f);
+  static vk::ImageAspectFlags getDepthAspect(vk::Format f);
+  // Records an update of a region of a uniform buffer with host data. Must be
+  // recorded outside of a render pass. Draws recorded earlier still see the
+  // previous contents, draws recorded later see the new ones.
+  static void recordUniformBufferUpdate(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer,
+                                        std::shared_ptr<vkhlf::Buffer> buffer,
+                                        size_t offset, size_t size, const char* data);
+  /* Orders shader accesses to storage buffers and images of the command
+   * recorded next after those of preceding commands. Commands that write
+   * storage wait for all preceding shader work. Commands that only read it
+   * wait only if storage was written since the last barrier, otherwise no
+   * barrier is recorded. Must be recorded outside of a render pass. */
+  static void recordShaderStorageBarrier(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer, bool writes);
 };
 
 } // namespace sga
@@ -40,6 +40,31 @@ private:
   unsigned int n;
 };
 
+class StorageBuffer::Impl{
+public:
+  Impl(DataLayout layout, unsigned int n);
+
+  DataLayout getLayout() const {return layout;}
+  unsigned int getSize() const {return n;}
+
+  void putData(uint8_t* pData, size_t n_elem, size_t elem_size);
+  void getData(uint8_t* pData, size_t n_elem, size_t elem_size);
+
+  friend class Pipeline;
+private:
+  std::shared_ptr<vkhlf::Buffer> buffer;
+  DataLayout layout;
+  unsigned int n;
+  // Offsets of values within an element, and the size of an element in
+  // std430 layout.
+  std::vector<size_t> offsets;
+  size_t stride;
+  size_t getByteSize() const {return stride * n;}
+  // Copies between the buffer and a staging buffer. Also makes writes of
+  // shaders visible to the copy, and the copy visible to shaders.
+  void copy(std::shared_ptr<vkhlf::Buffer> from, std::shared_ptr<vkhlf::Buffer> to);
+};
+
 } // namespace sga
 
 #endif // __VBO_IMPL_HPP__
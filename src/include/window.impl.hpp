@@ -9,6 +9,7 @@
 #include <vkhlf/vkhlf.h>
 
 #include <functional>
+#include <map>
 
 namespace sga{
 
@@ -54,10 +55,21 @@ public:
   static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
   void setClearColor(ImageClearColor cc);
+  // Requests the current frame to be cleared. The clear is deferred, so that
+  // it can be performed by the next render pass onto this window.
   void clearCurrentFrame();
-  void clearCurrentFrame(vk::ClearColorValue cc);
+  // Clears the current frame right away, if a clear is still pending.
+  void flushClear();
+  void clearCurrentFrameNow(vk::ClearColorValue cc);
+
+  void setMultisampling(unsigned int samples);
+  void setDepthFormat(DepthFormat format);
+  void setDepthClearValue(float value);
 
   void createSwapchainsAndFramebuffer();
+  std::shared_ptr<vkhlf::RenderPass> createRenderPass(vk::SampleCountFlagBits samples, bool clear);
+  void createRenderPasses();
+  void createMultisampleTargets();
   void setRenderPass(vkhlf::RenderPass);
 private:
   GLFWwindow* window;
@@ -72,23 +84,35 @@ private:
   
   vk::Format colorFormat;
   vk::Format depthFormat;
+  float depthClearValue = 1.0f;
   
   std::shared_ptr<vkhlf::Surface> surface;
+
+  // The single-sampled render pass which swapchain framebuffers are made for.
+  std::shared_ptr<vkhlf::RenderPass> swapchainRenderPass;
+  // When multisampling, rendering happens onto these images, and results are
+  // resolved onto swapchain images using framebuffers from msFramebuffers.
+  std::shared_ptr<vkhlf::Image> msColorImage, msDepthImage;
+  std::shared_ptr<vkhlf::ImageView> msColorView, msDepthView;
+  std::map<vkhlf::Image*, std::shared_ptr<vkhlf::Framebuffer>> msFramebuffers;
   
 public: // TODO: friend Pipeline? getter?
   std::shared_ptr<vkhlf::RenderPass> renderPass;
+  // Compatible with renderPass, but clears all attachments on load.
+  std::shared_ptr<vkhlf::RenderPass> renderPassClear;
+  // Number of samples per pixel used by the render passes above.
+  vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+  // True if the current frame was requested to be cleared, but no render pass
+  // or explicit clear did it yet.
+  bool pendingClear = false;
+  std::vector<vk::ClearValue> getClearValues();
   // This gets flipped to true when there is data for current frame available for presentation.
   bool currentFrameRendered = false;
 
   std::pair<
     std::shared_ptr<vkhlf::Framebuffer>,
     vk::Extent2D>
-  getCurrentFramebuffer(){
-    return std::make_pair(
-      framebufferSwapchain->getFramebuffer(),
-      framebufferSwapchain->getExtent()
-      );
-  }
+  getCurrentFramebuffer();
   std::shared_ptr<vkhlf::Image> getCurrentImage(){
     return framebufferSwapchain->getColorImage();
   }
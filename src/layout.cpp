@@ -2,6 +2,7 @@
 
 #include <map>
 #include <numeric>
+#include <algorithm>
 
 #include "utils.hpp"
 
@@ -89,6 +90,21 @@ size_t getAnnotatedDataLayoutUBOSize(const std::vector<std::pair<DataType, std::
   return total;
 }
 
+size_t getDataLayoutStd430Offsets(const DataLayout& layout, std::vector<size_t>& offsets){
+  // For the supported types, member alignment is the same as in std140.
+  // Unlike std140, structs are not padded to a multiple of 16 bytes.
+  size_t total = 0, maxAlignment = 1;
+  offsets.clear();
+  for(DataType dt : layout.layout){
+    size_t alignment = getDataTypeGLSLstd140Alignment(dt);
+    maxAlignment = std::max(maxAlignment, alignment);
+    total = align(total, alignment);
+    offsets.push_back(total);
+    total += getDataTypeSize(dt);
+  }
+  return align(total, maxAlignment);
+}
+
 size_t DataLayout::byteSize() const{
   return std::accumulate(
     layout.begin(), layout.end(),
@@ -0,0 +1,42 @@
+#include "pingpong.impl.hpp"
+
+#include <sga/exceptions.hpp>
+
+namespace sga{
+
+PingPong::Impl::Impl(int width, int height, unsigned int channels, ImageFormat format){
+  if(format == ImageFormat::Depth || format == ImageFormat::Depth16)
+    ImageFormatError("DepthPingPong", "A PingPong cannot use a depth image format.").raise();
+  images.emplace_back(width, height, channels, format);
+  images.emplace_back(width, height, channels, format);
+  for(unsigned int i = 0; i < 2; i++)
+    pipelines[i].setTarget({images[1 - i]});
+}
+
+void PingPong::Impl::setProgram(const Program& program, std::string samplerName,
+                                SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
+  for(unsigned int i = 0; i < 2; i++){
+    pipelines[i].setProgram(program);
+    pipelines[i].setSampler(samplerName, images[i], interpolation, warp_mode);
+  }
+  programSet = true;
+}
+
+void PingPong::Impl::setSampler(std::string name, const Image& image,
+                                SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
+  for(auto& p : pipelines)
+    p.setSampler(name, image, interpolation, warp_mode);
+}
+
+void PingPong::Impl::iterate(unsigned int n){
+  if(!programSet)
+    PipelineConfigError("NoProgram", "Cannot iterate a PingPong with no program set.").raise();
+  // Draws and layout switches are all recorded into the chained command
+  // buffer, nothing waits for the device here.
+  for(unsigned int i = 0; i < n; i++){
+    pipelines[current].drawFullQuad();
+    current = 1 - current;
+  }
+}
+
+} // namespace sga
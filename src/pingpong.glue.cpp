@@ -0,0 +1,40 @@
+#include <sga/pingpong.hpp>
+#include "pingpong.impl.hpp"
+
+namespace sga {
+
+PingPong::PingPong(int width, int height, unsigned int channels, ImageFormat format)
+  : impl(std::make_shared<PingPong::Impl>(width, height, channels, format)) {
+}
+
+PingPong::~PingPong() = default;
+
+void PingPong::setProgram(const Program& program, std::string samplerName,
+                          SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
+  impl->setProgram(program, samplerName, interpolation, warp_mode);
+}
+
+void PingPong::setSampler(std::string name, const Image& image,
+                          SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
+  impl->setSampler(name, image, interpolation, warp_mode);
+}
+
+void PingPong::iterate(unsigned int n){
+  impl->iterate(n);
+}
+
+Image& PingPong::getCurrent(){
+  return impl->getCurrent();
+}
+
+void PingPong::setUniform(const std::string& name, std::initializer_list<float> floats){
+  for(auto& p : impl->pipelines)
+    p.setUniform(name, floats);
+}
+
+void PingPong::setUniform(DataType dt, const std::string& name, char* pData, size_t size){
+  for(auto& p : impl->pipelines)
+    p.setUniform(dt, name, pData, size);
+}
+
+} // namespace sga
@@ -13,8 +13,13 @@
 #include "vbo.impl.hpp"
 #include "shader.impl.hpp"
 #include "image.impl.hpp"
+#include "uniformring.hpp"
+#include "query.impl.hpp"
+#include "chain.impl.hpp"
 #include "layout.hpp"
 #include "scheduler.hpp"
+#include "descriptors.hpp"
+#include "frame.hpp"
 
 namespace sga{
 
@@ -26,10 +31,12 @@ Pipeline::Impl::~Impl(){
 
 void Pipeline::Impl::setTarget(const Window& tgt){
   cooked = false;
+  validated = false;
   target_is_window = true;
   targetWindow = tgt.impl;
   // Drop references to image targets
   targetImages = std::vector<std::shared_ptr<Image::Impl>>();
+  depthTarget = nullptr;
   rp_renderpass = nullptr;
   rp_framebuffer = nullptr;
   renderpass_prepared = false;
@@ -39,25 +46,55 @@ void Pipeline::Impl::setTarget(const Window& tgt){
 
 void Pipeline::Impl::setTarget(std::vector<Image> images){
   targetImages.clear();
+  depthTarget = nullptr;
   for(const Image& i : images){
     const auto image = i.impl;
-    // Ensure images are not used for sampling.
-    for(const auto& sp : s_samplers){
-      if(sp.second.image == image){
-        PipelineConfigError("InvalidTargetImageUsage", "An image cannot be both render target and sampler source in the same pipeline.");
+    // Ensure images are not used for sampling by any program.
+    for(const auto& state : programStates){
+      for(const auto& sp : state.second.s_samplers){
+        for(const auto& e : sp.second.elements)
+          if(e.image == image){
+            PipelineConfigError("InvalidTargetImageUsage", "An image cannot be both render target and sampler source in the same pipeline.").raise();
+          }
       }
     }
-    targetImages.push_back(image);
+    if(image->isDepth()){
+      if(depthTarget)
+        PipelineConfigError("MultipleDepthTargets", "At most one depth image can be used as a render target.").raise();
+      depthTarget = image;
+    }else{
+      targetImages.push_back(image);
+    }
   }
 
   cooked = false;
+  validated = false;
   target_is_window = false;
   renderpass_prepared = false;
   targetWindow = nullptr;
+  // Internal attachments are reused between targets, but their contents
+  // belong to the previous ones. Without multisampling, color attachments
+  // are the targets themselves and keep their contents.
+  rp_depthPendingClear = true;
+  if(samples != vk::SampleCountFlagBits::e1)
+    rp_msPendingClear = true;
 
   resetViewport();
 }
 
+void Pipeline::Impl::setTargetLayer(unsigned int layer){
+  if(targetLayer == int(layer)) return;
+  targetLayer = layer;
+  // Framebuffers for each layer are cached separately.
+  renderpass_prepared = false;
+}
+
+void Pipeline::Impl::setTargetAllLayers(){
+  if(targetLayer < 0) return;
+  targetLayer = -1;
+  renderpass_prepared = false;
+}
+
 void Pipeline::Impl::setFaceCull(FaceCullMode fcm, FaceDirection fd){
   faceCullMode = fcm;
   faceDirection = fd;
@@ -82,12 +119,88 @@ void Pipeline::Impl::setBlendModeColor(BlendFactor src, BlendFactor dst, BlendOp
   blendFactorColorSrc = src;
   blendFactorColorDst = dst;
   blendOperationColor = op;
+  cooked = false;
 }
 
 void Pipeline::Impl::setBlendModeAlpha(BlendFactor src, BlendFactor dst, BlendOperation op){
   blendFactorAlphaSrc = src;
   blendFactorAlphaDst = dst;
   blendOperationAlpha = op;
+  cooked = false;
+}
+
+void Pipeline::Impl::setDepthTest(bool enabled){
+  depthTest = enabled;
+  cooked = false;
+}
+
+void Pipeline::Impl::setDepthWrite(bool enabled){
+  depthWrite = enabled;
+  cooked = false;
+}
+
+void Pipeline::Impl::setDepthCompare(CompareOp op){
+  depthCompare = op;
+  cooked = false;
+}
+
+void Pipeline::Impl::setDepthFormat(DepthFormat format){
+  vk::Format f = Utils::getDepthFormat(format);
+  if(f == depthFormat) return;
+  depthFormat = f;
+  // Render passes and pipelines for the new format are cached separately.
+  renderpass_prepared = false;
+  cooked = false;
+}
+
+vk::Format Pipeline::Impl::getDepthFormat() const{
+  return depthTarget ? depthTarget->format.vkFormat : depthFormat;
+}
+
+void Pipeline::Impl::setDepthClearValue(float value){
+  depthClearValue = value;
+}
+
+void Pipeline::Impl::setReverseZ(bool enabled){
+  setDepthCompare(enabled ? CompareOp::GreaterOrEqual : CompareOp::LessOrEqual);
+  setDepthClearValue(enabled ? 0.0f : 1.0f);
+}
+
+void Pipeline::Impl::setTargetUsageHint(TargetUsageHint hint){
+  if(hint == TargetUsageHint::Discard)
+    PipelineConfigError("InvalidUsageHint", "Image targets cannot be discarded, as they hold the results of rendering.").raise();
+  if(hint == targetUsageHint) return;
+  targetUsageHint = hint;
+  // Render passes for the new hint are cached separately.
+  renderpass_prepared = false;
+  cooked = false;
+}
+
+void Pipeline::Impl::setDepthUsageHint(TargetUsageHint hint){
+  if(hint == TargetUsageHint::Overwrite)
+    PipelineConfigError("InvalidUsageHint", "The depth buffer cannot use the Overwrite usage hint.", "The depth buffer must be either loaded or cleared before it is used for depth testing.").raise();
+  if(hint == depthUsageHint) return;
+  depthUsageHint = hint;
+  // The depth image needs to be recreated as well.
+  renderpass_prepared = false;
+  cooked = false;
+}
+
+void Pipeline::Impl::setMultisampling(unsigned int s){
+  vk::SampleCountFlagBits flag = Utils::getSampleCountFlag(s);
+  if(flag == samples) return;
+  samples = flag;
+  // Render passes and pipelines for the new sample count are cached separately.
+  renderpass_prepared = false;
+  cooked = false;
+}
+
+void Pipeline::Impl::setOcclusionQuery(std::shared_ptr<OcclusionQuery::Impl> query){
+  occlusionQuery = query;
+}
+
+void Pipeline::Impl::setDrawCondition(std::shared_ptr<OcclusionQuery::Impl> query){
+  drawCondition = query;
 }
 
 static inline vk::BlendFactor blendModeSGA2VK(sga::BlendFactor m){
@@ -102,6 +215,20 @@ static inline vk::BlendFactor blendModeSGA2VK(sga::BlendFactor m){
   }
 }
 
+static inline vk::CompareOp compareOpSGA2VK(sga::CompareOp op){
+  switch(op){
+    case sga::CompareOp::Never:   return vk::CompareOp::eNever;
+    case sga::CompareOp::Less:    return vk::CompareOp::eLess;
+    case sga::CompareOp::Equal:   return vk::CompareOp::eEqual;
+    case sga::CompareOp::LessOrEqual: return vk::CompareOp::eLessOrEqual;
+    case sga::CompareOp::Greater: return vk::CompareOp::eGreater;
+    case sga::CompareOp::NotEqual: return vk::CompareOp::eNotEqual;
+    case sga::CompareOp::GreaterOrEqual: return vk::CompareOp::eGreaterOrEqual;
+    case sga::CompareOp::Always:  return vk::CompareOp::eAlways;
+  default: return vk::CompareOp::eLessOrEqual;
+  }
+}
+
 static inline vk::BlendOp blendOpSGA2VK(sga::BlendOperation op){
   switch(op){
     case sga::BlendOperation::Add:      return vk::BlendOp::eAdd;
@@ -131,9 +258,9 @@ void Pipeline::Impl::prepareVp(){
       auto extent = targetWindow->getCurrentFramebuffer().second;
       vp_right = extent.width;
       vp_bottom = extent.height;
-    }else if(!target_is_window && targetImages[0]){
-      vp_right = targetImages[0]->getWidth();
-      vp_bottom = targetImages[0]->getHeight();
+    }else if(!target_is_window && getTargetSizeImage()){
+      vp_right = getTargetSizeImage()->getWidth();
+      vp_bottom = getTargetSizeImage()->getHeight();
     }
   }
 }
@@ -145,13 +272,32 @@ void Pipeline::Impl::setProgram(const Program& p_){
                         "The program passed to a pipeline must be compiled first, using Program::compile() method.").raise();
   if(p->isFullQuad)
     PipelineConfigError("InvalidProgramType", "This pipeline does not support full quad programs.").raise();
+  if(p->isCompute)
+    PipelineConfigError("InvalidProgramType", "This pipeline does not support compute programs.").raise();
 
   program = p;
   cooked = false;
-  samplers_prepared = descset_prepared = unibuffers_prepared = false;
+  validated = false;
+  switchProgramState(p);
+}
+
+void Pipeline::Impl::switchProgramState(std::shared_ptr<Program::Impl> p){
+  // Drop states of programs that no longer exist. This happens before the
+  // lookup, as a new program may reuse the address of a destroyed one.
+  for(auto it = programStates.begin(); it != programStates.end();){
+    if(it->second.program.expired()) it = programStates.erase(it);
+    else ++it;
+  }
+  ps = &programStates[p.get()];
+  ps->program = p;
 }
 
-void Pipeline::Impl::setUniform(std::string name, std::initializer_list<float> floats){
+void Pipeline::Impl::clearPipelineVariants(std::shared_ptr<vkhlf::RenderPass> rp){
+  for(auto& state : programStates)
+    state.second.c_pipelineVariants.erase(rp);
+}
+
+void Pipeline::Impl::setUniform(const std::string& name, std::initializer_list<float> floats){
   if(floats.size() == 1){
     setUniform(DataType::Float, name, (char*)floats.begin(), 1*4);
   }else if(floats.size() == 2){
@@ -169,13 +315,13 @@ void Pipeline::Impl::setUniform(std::string name, std::initializer_list<float> f
   }
 }
 
-void Pipeline::Impl::setUniform(DataType dt, std::string name, char* pData, size_t size, bool standard){
+void Pipeline::Impl::setUniform(DataType dt, const std::string& name, char* pData, size_t size){
   if(size != getDataTypeSize(dt)){
     // TODO: Name types in output?
     DataFormatError("UniformSizeMismatch", "setUniform failed: Provided input has different size than declared data type!").raise();
   }
 
-  if(!standard && name.substr(0,3) == "sga")
+  if(name.compare(0, 3, "sga") == 0)
     PipelineConfigError("SpecialUniform", "Cannot set the value of a standard uniform.", "Uniforms with names beginning with `sga` have a special meaning, and you cannot manually assign values to them.").raise();
 
   if(!program)
@@ -184,21 +330,68 @@ void Pipeline::Impl::setUniform(DataType dt, std::string name, char* pData, size
   prepare_unibuffers();
 
   // Lookup offset.
-  const auto& off_map = program->c_uniformOffsets;
-  auto it = off_map.find(name);
-  if(it == off_map.end())
+  const auto& u_map = program->c_uniforms;
+  auto it = u_map.find(name);
+  if(it == u_map.end())
     PipelineConfigError("NoUniform", "Uniform \"" + name + "\" does not exist.").raise();
-  if(it->second.second != dt)
+  if(it->second.type != dt)
     DataFormatError("UniformDataTypeMimatch", "The data type of uniform " + name + " is different than the value written to it.").raise();
 
-  size_t offset = it->second.first;
-  memcpy(b_uniformHostBuffer + offset, pData, size);
+  memcpy(ps->b_uniformHostBuffer + it->second.offset, pData, size);
+  ps->markDirty(it->second.offset, size);
 
-  // Mark the uniform as set.
-  uniformsSet.insert(name);
+  markUniformSet(it->second.index);
+}
+
+void Pipeline::Impl::setUniform(DataType dt, const void* handleProgram, size_t offset, DataType handleType, unsigned int index, char* pData, size_t size){
+  if(!program || handleProgram != program.get())
+    PipelineConfigError("InvalidUniformHandle", "This uniform handle does not refer to a uniform of the current program of this pipeline.", "A uniform handle can only be used while the program it was obtained for is set on the pipeline.").raise();
+  if(handleType != dt)
+    DataFormatError("UniformDataTypeMimatch", "The data type of the uniform is different than the value written to it.").raise();
+  if(size != getDataTypeSize(dt) || offset + size > ps->b_uniformSize)
+    DataFormatError("UniformSizeMismatch", "setUniform failed: Provided input has different size than declared data type!").raise();
+
+  memcpy(ps->b_uniformHostBuffer + offset, pData, size);
+  ps->markDirty(offset, size);
+
+  markUniformSet(index);
+}
+
+void Pipeline::Impl::getUniformHandle(const std::string& name, const void*& handleProgram, size_t& offset, DataType& type, unsigned int& index){
+  if(!program)
+    PipelineConfigError("NoProgram", "Cannot get uniform handles when no program is set.").raise();
+  if(name.compare(0, 3, "sga") == 0)
+    PipelineConfigError("SpecialUniform", "Cannot set the value of a standard uniform.", "Uniforms with names beginning with `sga` have a special meaning, and you cannot manually assign values to them.").raise();
+
+  prepare_unibuffers();
+
+  auto it = program->c_uniforms.find(name);
+  if(it == program->c_uniforms.end())
+    PipelineConfigError("NoUniform", "Uniform \"" + name + "\" does not exist.").raise();
+
+  handleProgram = program.get();
+  offset = it->second.offset;
+  type = it->second.type;
+  index = it->second.index;
+}
+
+void Pipeline::Impl::markUniformSet(unsigned int index){
+  if(ps->uniformsSet[index]) return;
+  ps->uniformsSet[index] = true;
+  ps->uniformsSetCount++;
 }
 
 void Pipeline::Impl::setSampler(std::string name, const Image& image_ref, SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
+  if(program){
+    prepare_samplers();
+    auto it = ps->s_samplers.find(name);
+    if(it != ps->s_samplers.end() && it->second.arraySize > 0)
+      PipelineConfigError("SamplerIsArray", "Sampler \"" + name + "\" is an array, an element index must be specified.").raise();
+  }
+  setSampler(name, 0, image_ref, interpolation, warp_mode);
+}
+
+void Pipeline::Impl::setSampler(std::string name, unsigned int index, const Image& image_ref, SamplerInterpolation interpolation, SamplerWarpMode warp_mode){
   if(!program)
     PipelineConfigError("NoProgram", "Cannot set uniforms when no program is set.").raise();
   std::shared_ptr<Image::Impl> image = image_ref.impl;
@@ -210,13 +403,21 @@ void Pipeline::Impl::setSampler(std::string name, const Image& image_ref, Sample
       PipelineConfigError("InvalidSamplerImageUsage", "An image cannot be both sampler source and render target in the same pipeline.");
     }
   }
+  if(image == depthTarget)
+    PipelineConfigError("InvalidSamplerImageUsage", "An image cannot be both sampler source and render target in the same pipeline.").raise();
 
   prepare_samplers();
-  prepare_descset();
 
-  auto it = s_samplers.find(name);
-  if(it == s_samplers.end())
+  auto it = ps->s_samplers.find(name);
+  if(it == ps->s_samplers.end())
     PipelineConfigError("NoSampler", "Sampler \"" + name + "\" does not exist.").raise();
+  if(index >= it->second.elements.size())
+    PipelineConfigError("SamplerIndexOutOfRange", "Sampler \"" + name + "\" has " + std::to_string(it->second.elements.size()) + " elements, cannot set element " + std::to_string(index) + ".").raise();
+  bool shadow = it->second.shadow;
+  if(shadow && !image->isDepth())
+    PipelineConfigError("ShadowSamplerNotDepth", "Shadow sampler \"" + name + "\" can only be bound to an image of Depth format.").raise();
+  if(image->getType() != it->second.type)
+    PipelineConfigError("SamplerImageTypeMismatch", "The type of the image does not match the declaration of sampler \"" + name + "\".").raise();
 
   vk::Filter filter;
   switch(interpolation){
@@ -239,40 +440,84 @@ void Pipeline::Impl::setSampler(std::string name, const Image& image_ref, Sample
   default:
     break;
   case ImageFilterMode::Anisotropic:
-    // TODO: Store device limits somewhere globally.
-    max_anisotropy = global::physicalDevice->getProperties().limits.maxSamplerAnisotropy;
-    enable_anisotropy = true;
+    if(global::deviceFeatures.samplerAnisotropy){
+      max_anisotropy = global::deviceLimits.maxSamplerAnisotropy;
+      enable_anisotropy = true;
+    }
     /* FALLTHROGH */
   case ImageFilterMode::MipMapped:
     maxLod = image->getDesiredMipsNo();
     break;
   }
 
-  auto& sdata = it->second;
+  auto& sdata = it->second.elements[index];
   sdata.image = image;
   sdata.sampler = global::device->createSampler(
     filter, filter,
     vk::SamplerMipmapMode::eLinear,
     amode, amode, amode,
-    0.0f, enable_anisotropy, max_anisotropy, false,
-    vk::CompareOp::eNever, minLod, maxLod,
+    0.0f, enable_anisotropy, max_anisotropy, shadow,
+    shadow ? vk::CompareOp::eLessOrEqual : vk::CompareOp::eNever, minLod, maxLod,
     vk::BorderColor::eFloatOpaqueWhite, false);
 
+  // The new binding will be written to a fresh descriptor set on next draw.
+  ps->d_descriptorSetDirty = true;
+  ps->bindings_validated = false;
+}
 
-  std::vector<vkhlf::WriteDescriptorSet> wdss;
-  wdss.push_back(vkhlf::WriteDescriptorSet(
-                   d_descriptorSet, sdata.bindno, 0, 1,
-                   vk::DescriptorType::eCombinedImageSampler,
-                   vkhlf::DescriptorImageInfo(sdata.sampler, image->image_view, vk::ImageLayout::eGeneral),
-                   nullptr
-                   ));
-  global::device->updateDescriptorSets(wdss, nullptr);
+void Pipeline::Impl::setStorageBuffer(std::string name, const StorageBuffer& buffer_ref){
+  if(!program)
+    PipelineConfigError("NoProgram", "Cannot set storage buffers when no program is set.").raise();
+  std::shared_ptr<StorageBuffer::Impl> buffer = buffer_ref.impl;
+
+  prepare_samplers();
+
+  auto it = ps->s_storageBuffers.find(name);
+  if(it == ps->s_storageBuffers.end())
+    PipelineConfigError("NoStorageBuffer", "Storage buffer \"" + name + "\" does not exist.").raise();
+  if(buffer->layout != it->second.layout)
+    PipelineConfigError("StorageBufferLayoutMismatch", "The layout of the buffer does not match the fields of storage buffer \"" + name + "\".").raise();
+
+  it->second.buffer = buffer;
+
+  // The new binding will be written to a fresh descriptor set on next draw.
+  ps->d_descriptorSetDirty = true;
+  ps->bindings_validated = false;
 }
 
-void Pipeline::Impl::updateStandardUniforms(){
-  float time = getTime();
-  setUniform(DataType::Float, "sgaTime", (char*)&time, sizeof(time), true);
+void Pipeline::Impl::setInputAttachment(std::string name, const Image& image_ref){
+  if(!program)
+    PipelineConfigError("NoProgram", "Cannot set input attachments when no program is set.").raise();
+  std::shared_ptr<Image::Impl> image = image_ref.impl;
 
+  prepare_samplers();
+
+  auto it = ps->s_inputAttachments.find(name);
+  if(it == ps->s_inputAttachments.end())
+    PipelineConfigError("NoInputAttachment", "Input attachment \"" + name + "\" does not exist.").raise();
+  if(!image->supportsInputAttachment)
+    PipelineConfigError("InputAttachmentUsageMissing", "Only images created with ImageUsage::InputAttachment can be bound to input attachments.").raise();
+  // Formats only need to agree on whether values are floats, signed or
+  // unsigned integers.
+  const auto& declared = program->c_inputAttachments[name];
+  if(image->isDepth() ||
+     getFormatProperties(1, image->userFormat).shaderDataType != getFormatProperties(1, declared.format).shaderDataType)
+    PipelineConfigError("InputAttachmentFormatMismatch", "The format of the image does not match the declaration of input attachment \"" + name + "\".").raise();
+  if(image->getLayers() != 1)
+    PipelineConfigError("InputAttachmentLayered", "Images with multiple layers cannot be bound to input attachments.").raise();
+
+  it->second.image = image;
+
+  // The new binding will be written to a fresh descriptor set on next draw.
+  ps->d_descriptorSetDirty = true;
+  ps->bindings_validated = false;
+}
+
+bool Pipeline::Impl::isChainRecording() const{
+  return chain && chain->recording;
+}
+
+void Pipeline::Impl::updateStandardUniforms(){
   vk::Extent2D extent;
   if(target_is_window){
     extent = targetWindow->getCurrentFramebuffer().second;
@@ -280,37 +525,57 @@ void Pipeline::Impl::updateStandardUniforms(){
     prepare_renderpass();
     extent = rp_image_target_extent;
   }
-  float e[2] = {(float)extent.width, (float)extent.height};
-  setUniform(DataType::Float2, "sgaResolution", (char*)&e, sizeof(e), true);
+  standardConstants.resolution[0] = extent.width;
+  standardConstants.resolution[1] = extent.height;
 
   prepareVp();
-  float vp[4] = {vp_left, vp_top, vp_right-vp_left, vp_bottom-vp_top};
-  setUniform(DataType::Float4, "sgaViewport", (char*)&vp, sizeof(vp), true);
+  standardConstants.viewport[0] = vp_left;
+  standardConstants.viewport[1] = vp_top;
+  standardConstants.viewport[2] = vp_right - vp_left;
+  standardConstants.viewport[3] = vp_bottom - vp_top;
 }
 
 void Pipeline::Impl::draw(const VBO& vbo_){
   auto vbo = vbo_.impl;
   if(!ensureValidity()) return;
 
+#ifndef SGA_NO_RUNTIME_VALIDATION
   // Extra VBO-specific validity check
   if(vbo->layout != program->c_inputLayout){
     PipelineConfigError("VertexLayoutMismatch", "VBO layout does not match pipeline input layout!").raise();
   }
+#endif
 
   cook();
   updateStandardUniforms();
   drawBuffer(vbo->buffer, vbo->getSize());
 }
 
+void Pipeline::Impl::drawProcedural(unsigned int n){
+  if(!ensureValidity()) return;
+
+#ifndef SGA_NO_RUNTIME_VALIDATION
+  if(program->c_inputLayout.layout.size() != 0){
+    PipelineConfigError("VertexLayoutMismatch", "Procedural draws require a vertex shader with no inputs.").raise();
+  }
+#endif
+
+  cook();
+  updateStandardUniforms();
+  drawBuffer(nullptr, n);
+}
+
 void Pipeline::Impl::drawIndexed(const VBO& vbo_, const IBO& ibo_){
   auto vbo = vbo_.impl;
   auto ibo = ibo_.impl;
   if(!ensureValidity()) return;
 
+#ifndef SGA_NO_RUNTIME_VALIDATION
   // Extra VBO-specific validity check
   if(vbo->layout != program->c_inputLayout){
     PipelineConfigError("VertexLayoutMismatch", "VBO layout does not match pipeline input layout!").raise();
   }
+#endif
 
   cook();
   updateStandardUniforms();
@@ -318,10 +583,13 @@ void Pipeline::Impl::drawIndexed(const VBO& vbo_, const IBO& ibo_){
 }
 
 bool Pipeline::Impl::ensureValidity(){
+#ifndef SGA_NO_RUNTIME_VALIDATION
+  if(validated) return true;
+
   if(!program){
     PipelineConfigError("ProgramNotSet", "This pipeline is not ready for rendering, the program was not set.").raise();
   }
-  if(!targetWindow && targetImages.size() == 0){
+  if(!targetWindow && targetImages.size() == 0 && !depthTarget){
     PipelineConfigError("RenderTargetMissing", "The pipeline is not ready for rendering, target surface not set.").raise();
   }
   // Check PX output layout with target.
@@ -345,90 +613,300 @@ bool Pipeline::Impl::ensureValidity(){
     }
     }
   }
+  validated = true;
+#endif
   return true;
 }
 
+void Pipeline::Impl::ensureBindingsValidity(){
+#ifndef SGA_NO_RUNTIME_VALIDATION
+  if(ps->bindings_validated) return;
+
+  // Ensure all samplers are set
+  for(const auto & s: ps->s_samplers){
+    bool any_set = false;
+    for(const auto& e : s.second.elements)
+      if(e.sampler) any_set = true;
+    if(!any_set)
+      PipelineConfigError("SamplerNotSet", "This pipeline cannot render, sampler \"" + s.first + "\" was not bound to an image.").raise();
+  }
+  for(const auto & s: ps->s_storageBuffers){
+    if(!s.second.buffer)
+      PipelineConfigError("StorageBufferNotSet", "This pipeline cannot render, storage buffer \"" + s.first + "\" was not bound to a buffer.").raise();
+  }
+  for(const auto & s: ps->s_storageImages){
+    if(!s.second.image)
+      PipelineConfigError("StorageImageNotSet", "This pipeline cannot dispatch, storage image \"" + s.first + "\" was not bound to an image.").raise();
+  }
+  for(const auto & s: ps->s_inputAttachments){
+    if(!s.second.image)
+      PipelineConfigError("InputAttachmentNotSet", "This pipeline cannot render, input attachment \"" + s.first + "\" was not bound to an image.").raise();
+  }
+
+  // Ensure all uniforms are set
+  if(ps->uniformsSetCount != ps->uniformsSet.size()){
+    for(const auto& u : program->c_uniforms){
+      if(!ps->uniformsSet[u.second.index]){
+        PipelineConfigError("UniformNotSet", "This pipeline cannot render, uniform \"" + u.first + "\" was not set.").raise();
+      }
+    }
+  }
+
+  ps->bindings_validated = true;
+#endif
+}
+
 void Pipeline::Impl::drawBuffer(std::shared_ptr<vkhlf::Buffer> buffer, unsigned int n, std::shared_ptr<vkhlf::Buffer> indices, unsigned int indices_n){
-  std::shared_ptr<vkhlf::Framebuffer> framebuffer;
-  vk::Extent2D extent;
-  if(target_is_window){
-    std::tie(framebuffer, extent) = targetWindow->getCurrentFramebuffer();
+  // The condition is evaluated using results of previous frames, as waiting
+  // for the device would stall rendering. Skipped draws leave pending clears
+  // of targets deferred.
+  if(drawCondition && !drawCondition->isVisible())
+    return;
+
+  // Draws of a recording chain are performed by the chain's render pass.
+  bool chained = isChainRecording();
+  TargetPass pass;
+  if(chained){
+    chain->validateDraw(*this);
   }else{
-    prepare_renderpass();
-    framebuffer = rp_framebuffer;
-    extent = rp_image_target_extent;
+    if(!ps->s_inputAttachments.empty())
+      PipelineConfigError("InputAttachmentsOutsideChain", "Programs with input attachments can only draw within a chain.").raise();
+    pass = prepareTargetPass();
   }
 
-  // Configure layout for target images.
-  for(const auto& i : targetImages){
-    i->switchLayout(vk::ImageLayout::eColorAttachmentOptimal);
+  ensureBindingsValidity();
+
+  // Configure layout of sampled images
+  prepareSampledImages();
+
+  // Uniforms used by a previous draw of the chain are only read once the
+  // chain ends, so new values are copied to the uniform ring instead.
+  bool uniformsChanged = ps->b_dirtyBegin != ps->b_dirtyEnd;
+  if(chained && chainDrawn && (uniformsChanged || (ps->b_uniformsInRing && ps->d_descriptorSetDirty))){
+    acquire_ring_descset();
+  }else{
+    if(ps->b_uniformsInRing){
+      ps->markDirty(0, ps->b_uniformSize);
+      ps->d_descriptorSetDirty = true;
+      ps->b_uniformsInRing = false;
+    }
+    acquire_descset();
   }
 
-  // Ensure all samplers are set and configure their layout
-  for(const auto & s: s_samplers){
-    if(!s.second.sampler)
-      PipelineConfigError("SamplerNotSet", "This pipeline cannot render, sampler \"" + s.first + "\" was not bound to an image.").raise();
-    s.second.image->switchLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+  DrawCommands draw = prepareDrawCommands(buffer, n, indices, indices_n);
+
+  // Load-op clears only affect the render area, which must then span the
+  // entire target. Drawing is still limited to the viewport by the scissor.
+  vk::Rect2D renderArea = pass.clearValues.empty() ? draw.area : vk::Rect2D({0, 0}, pass.extent);
+
+  Scheduler::borrowChainableCmdBuffer(chained ? "chained draw" : "pipeline draw", [&](auto cmdBuffer){
+
+      if(occlusionQuery) draw.querySlot = occlusionQuery->prepareSlot(cmdBuffer);
+      global::frameUniforms->flush(cmdBuffer);
+      recordUniformUpload(cmdBuffer);
+      if(hasShaderStorage())
+        Utils::recordShaderStorageBarrier(cmdBuffer, writesShaderStorage());
+      if(chained) return;
+
+      cmdBuffer->beginRenderPass(pass.renderPass, pass.framebuffer, renderArea, pass.clearValues, vk::SubpassContents::eInline);
+      draw.record(cmdBuffer);
+      cmdBuffer->endRenderPass();
+    });
+
+  if(chained){
+    chain->deferDraw(chainSubpass, draw);
+    chainDrawn = true;
+  }else{
+    finishTargetPass();
   }
+}
 
-  // Ensure all uniforms are set
-  for(const auto& u : program->c_uniformOffsets){
-    if(uniformsSet.find(u.first) == uniformsSet.end()){
-      PipelineConfigError("UniformNotSet", "This pipeline cannot render, uniform \"" + u.first + "\" was not set.").raise();
-    }
+Pipeline::Impl::DrawCommands Pipeline::Impl::prepareDrawCommands(std::shared_ptr<vkhlf::Buffer> buffer, unsigned int n, std::shared_ptr<vkhlf::Buffer> indices, unsigned int indices_n){
+  DrawCommands draw;
+  draw.pipeline = c_pipeline;
+  draw.layout = program->c_pipelineLayout;
+  draw.descriptorSet = ps->d_descriptorSet;
+  draw.constants = standardConstants;
+
+  prepareVp();
+  draw.area = vk::Rect2D({(int)floor(vp_left), (int)floor(vp_top)},
+                         {(unsigned int)std::ceil(vp_right - vp_left), (unsigned int)std::ceil(vp_bottom - vp_top)});
+  draw.viewport = vk::Viewport(vp_left, vp_top, vp_right, vp_bottom, 0.0f, 1.0f);
+
+  draw.buffer = buffer;
+  draw.n = n;
+  draw.indices = indices;
+  draw.indices_n = indices_n;
+  draw.query = occlusionQuery;
+  return draw;
+}
+
+void Pipeline::Impl::DrawCommands::record(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer) const{
+  cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+  cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0,
+                                {descriptorSet, global::frameUniforms->getSet()}, nullptr);
+  cmdBuffer->pushConstants(layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                           0, vk::ArrayProxy<const StandardConstants>(constants));
+  cmdBuffer->setViewport(0, viewport);
+  cmdBuffer->setScissor(0, area);
+
+  if(query) query->begin(cmdBuffer, querySlot);
+  if(buffer) cmdBuffer->bindVertexBuffer(0, buffer, 0);
+  if(!indices){
+    cmdBuffer->draw(uint32_t(n), 1, 0, 0);
+  }else{
+    cmdBuffer->bindIndexBuffer(indices, 0, vk::IndexType::eUint16);
+    cmdBuffer->drawIndexed(uint32_t(indices_n), 1, 0, 0, 0);
   }
+  if(query) query->end(cmdBuffer, querySlot);
+}
 
-  // Prepare a new staging buffer.
-  std::shared_ptr<vkhlf::Buffer> uniform_staging_buffer = global::device->createBuffer(
-    b_uniformSize,
-    vk::BufferUsageFlagBits::eTransferSrc,
-    vk::SharingMode::eExclusive,
-    nullptr,
-    vk::MemoryPropertyFlagBits::eHostVisible,
-    nullptr);
-  // Fill it with data for current uniform state
-  auto sbdm = uniform_staging_buffer->get<vkhlf::DeviceMemory>();
-  void* pMapped = sbdm->map(0, b_uniformSize);
-  memcpy(pMapped, b_uniformHostBuffer, b_uniformSize);
-  sbdm->flush(0, b_uniformSize); sbdm->unmap();
-
-  // Have scheduler keep a reference to the buffer so that it doesn't get
-  // destroyed when this function ends (the copy may be performed much later).
-  Scheduler::appendChainedResource(uniform_staging_buffer);
+void Pipeline::Impl::recordDraw(Bundle::Impl::Segment& segment, const VBO& vbo_, const IBO* ibo_){
+  auto vbo = vbo_.impl;
+#ifndef SGA_NO_RUNTIME_VALIDATION
+  if(vbo->layout != program->c_inputLayout){
+    PipelineConfigError("VertexLayoutMismatch", "VBO layout does not match pipeline input layout!").raise();
+  }
+#endif
+  if(occlusionQuery || drawCondition)
+    PipelineConfigError("BundleWithQuery", "Draws using occlusion queries or draw conditions cannot be recorded into a bundle.").raise();
+  if(!ps->s_inputAttachments.empty())
+    PipelineConfigError("InputAttachmentsOutsideChain", "Programs with input attachments can only draw within a chain.").raise();
+
+  ensureBindingsValidity();
+
+  // The draw gets its own uniform buffer and descriptor set, so that later
+  // changes to this pipeline do not affect it.
+  Bundle::Impl::Draw draw;
+  auto uniformBuffer = createUniformBuffer();
+  auto descriptorSet = segment.descriptors->allocate(program->c_descriptorSetLayout, program->c_descriptorRequirements);
+  write_descset(descriptorSet, uniformBuffer);
+
+  // Uniform values never change, so they are uploaded once.
+  Scheduler::borrowChainableCmdBuffer("bundle uniforms", [&](auto cmdBuffer){
+      Utils::recordUniformBufferUpdate(cmdBuffer, uniformBuffer, 0, ps->b_uniformSize, ps->b_uniformHostBuffer);
+    });
+  for(const auto & s: ps->s_samplers)
+    for(const auto& e : s.second.elements)
+      if(e.sampler) draw.sampledImages.push_back(e.image);
+  for(const auto & s: ps->s_storageBuffers)
+    segment.resources.push_back(s.second.buffer);
+  if(hasShaderStorage()) segment.storage = true;
+  if(writesShaderStorage()) segment.storageWrites = true;
 
   prepareVp();
   vk::Rect2D area({(int)floor(vp_left), (int)floor(vp_top)},
                   {(unsigned int)std::ceil(vp_right - vp_left), (unsigned int)std::ceil(vp_bottom - vp_top)});
   vk::Viewport viewport(vp_left, vp_top, vp_right, vp_bottom, 0.0f, 1.0f);
-  
-  Scheduler::borrowChainableCmdBuffer("pipeline draw", [&](auto cmdBuffer){
-
-      cmdBuffer->beginRenderPass(c_renderPass, framebuffer, area, {}, vk::SubpassContents::eInline);
-
-      cmdBuffer->copyBuffer(uniform_staging_buffer, b_uniformDeviceBuffer, vk::BufferCopy(0, 0, b_uniformSize));
-
-      cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, c_pipeline);
-      cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, c_pipelineLayout, 0, {d_descriptorSet}, nullptr);
-      cmdBuffer->setViewport(0, viewport);
-      cmdBuffer->setScissor(0, area);
-      
-      cmdBuffer->bindVertexBuffer(0, buffer, 0);
-      if(!indices){
-        cmdBuffer->draw(uint32_t(n), 1, 0, 0);
-      }else{
-        cmdBuffer->bindIndexBuffer(indices, 0, vk::IndexType::eUint16);
-        cmdBuffer->drawIndexed(uint32_t(indices_n), 1, 0, 0, 0);
+
+  auto cmdBuffer = segment.commands;
+  cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, c_pipeline);
+  cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, program->c_pipelineLayout, 0,
+                                {descriptorSet, global::frameUniforms->getSet()}, nullptr);
+  cmdBuffer->pushConstants(program->c_pipelineLayout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                           0, vk::ArrayProxy<const StandardConstants>(standardConstants));
+  cmdBuffer->setViewport(0, viewport);
+  cmdBuffer->setScissor(0, area);
+  cmdBuffer->bindVertexBuffer(0, vbo->buffer, 0);
+  if(!ibo_){
+    cmdBuffer->draw(uint32_t(vbo->getSize()), 1, 0, 0);
+  }else{
+    auto ibo = ibo_->impl;
+    cmdBuffer->bindIndexBuffer(ibo->buffer, 0, vk::IndexType::eUint16);
+    cmdBuffer->drawIndexed(uint32_t(ibo->getSize()), 1, 0, 0, 0);
+    segment.resources.push_back(ibo->buffer);
+  }
+
+  segment.resources.push_back(c_pipeline);
+  segment.resources.push_back(program->c_pipelineLayout);
+  segment.resources.push_back(descriptorSet);
+  segment.resources.push_back(uniformBuffer);
+  segment.resources.push_back(vbo->buffer);
+  segment.draws.push_back(std::move(draw));
+}
+
+Pipeline::Impl::TargetPass Pipeline::Impl::prepareTargetPass(){
+  TargetPass pass;
+  if(target_is_window){
+    std::tie(pass.framebuffer, pass.extent) = targetWindow->getCurrentFramebuffer();
+  }else{
+    prepare_renderpass();
+    pass.framebuffer = rp_framebuffer;
+    pass.extent = rp_image_target_extent;
+    // The render pass only clears the layer it renders onto, other layers
+    // of pending clears are cleared on their own.
+    if(targetLayer >= 0){
+      for(const auto& i : targetImages)
+        if(i->getLayers() > 1) i->flushClear();
+      if(depthTarget && depthTarget->getLayers() > 1) depthTarget->flushClear();
+    }
+  }
+
+  // Configure layout for target images.
+  for(const auto& i : targetImages){
+    i->switchLayout(vk::ImageLayout::eColorAttachmentOptimal);
+  }
+  if(depthTarget)
+    depthTarget->switchLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+  // Pending clears of targets are performed by the render pass.
+  pass.renderPass = c_renderPass;
+  auto& clearValues = pass.clearValues;
+  if(target_is_window){
+    if(targetWindow->pendingClear){
+      pass.renderPass = targetWindow->renderPassClear;
+      clearValues = targetWindow->getClearValues();
+      targetWindow->pendingClear = false;
+    }
+  }else{
+    uint32_t clearMask = 0;
+    unsigned int n = targetImages.size();
+    bool msClear = rp_msPendingClear && samples != vk::SampleCountFlagBits::e1;
+    clearValues.resize(n + 1);
+    for(unsigned int i = 0; i < n; i++){
+      if(!targetImages[i]->pendingClear && !msClear) continue;
+      clearMask |= 1u << i;
+      clearValues[i] = vk::ClearValue(Utils::imageClearColorToVkClearColorValue(targetImages[i]->clearColor));
+      targetImages[i]->pendingClear = false;
+    }
+    rp_msPendingClear = false;
+    if(depthTarget){
+      if(depthTarget->pendingClear){
+        clearMask |= 1u << n;
+        clearValues[n] = vk::ClearValue(Utils::imageClearColorToVkClearDepthStencilValue(depthTarget->clearColor));
+        depthTarget->pendingClear = false;
       }
+    }else if(rp_depthPendingClear || depthDiscarded()){
+      // A discarded depth buffer must be cleared by every render pass.
+      clearMask |= 1u << n;
+      clearValues[n] = vk::ClearValue(vk::ClearDepthStencilValue(depthClearValue, 0));
+      rp_depthPendingClear = false;
+    }
+    if(clearMask) pass.renderPass = getRenderPassVariant(clearMask);
+    else clearValues.clear();
+  }
 
-      cmdBuffer->endRenderPass();
-    });
+  return pass;
+}
 
+void Pipeline::Impl::finishTargetPass(){
   if(target_is_window){
     targetWindow->currentFrameRendered = true;
   }else{
-    // Recalculate mipmaps in each target image.
+    // Mipmaps of target images are rebuilt once they are sampled.
     for(auto img : targetImages){
-      img->regenerateMips();
+      img->invalidateMips();
+    }
+  }
+}
+
+void Pipeline::Impl::prepareSampledImages(){
+  for(const auto & s: ps->s_samplers){
+    for(const auto& e : s.second.elements){
+      if(!e.sampler) continue;
+      e.image->flushClear();
+      e.image->flushMips();
+      e.image->switchLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
     }
   }
 }
@@ -436,6 +914,8 @@ void Pipeline::Impl::drawBuffer(std::shared_ptr<vkhlf::Buffer> buffer, unsigned
 void Pipeline::Impl::clear(){
   if(!ensureValidity()) return;
   
+  // These clears are deferred until the next draw, or until the contents of
+  // a target are needed.
   if(target_is_window){
     targetWindow->currentFrameRendered = true;
     targetWindow->clearCurrentFrame();
@@ -443,68 +923,141 @@ void Pipeline::Impl::clear(){
     for(const auto& i : targetImages){
       i->clear();
     }
-    // No need to clear the depth buffer if it wasn't craeted yet.
-    if(renderpass_prepared)
-      clearDepthImage();
+    if(depthTarget) depthTarget->clear();
+    else rp_depthPendingClear = true;
   }
 }
 
 void Pipeline::Impl::prepare_unibuffers(){
-  if(unibuffers_prepared) return;
+  if(ps->unibuffers_prepared) return;
 
-  b_uniformSize = program->c_uniformSize;
+  ps->b_uniformSize = program->c_uniformSize;
   // Prepare uniform buffers.
-  b_uniformDeviceBuffer = global::device->createBuffer(
-    b_uniformSize,
+  ps->b_uniformDeviceBuffer = createUniformBuffer();
+  if(ps->b_uniformHostBuffer != nullptr) delete[] ps->b_uniformHostBuffer;
+  ps->b_uniformHostBuffer = new char[ps->b_uniformSize];
+
+  memset(ps->b_uniformHostBuffer, 0, ps->b_uniformSize);
+  ps->markDirty(0, ps->b_uniformSize);
+
+  ps->uniformsSet.assign(program->c_uniforms.size(), false);
+  ps->uniformsSetCount = 0;
+
+  ps->unibuffers_prepared = true;
+}
+
+std::shared_ptr<vkhlf::Buffer> Pipeline::Impl::createUniformBuffer() const{
+  return global::device->createBuffer(
+    ps->b_uniformSize,
     vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eUniformBuffer,
     vk::SharingMode::eExclusive,
     nullptr,
     vk::MemoryPropertyFlagBits::eDeviceLocal);
-  if(b_uniformHostBuffer != nullptr) delete[] b_uniformHostBuffer;
-  b_uniformHostBuffer = new char[b_uniformSize];
-
-  unibuffers_prepared = true;
 }
 
 void Pipeline::Impl::prepare_samplers(){
-  if(samplers_prepared) return;
+  if(ps->samplers_prepared) return;
   for(const auto& s : program->c_samplerBindings){
-    s_samplers[s.first] = SamplerData(s.second);
+    ps->s_samplers[s.first] = SamplerData(s.second, program->c_samplerArraySizes[s.first],
+                                      program->c_shadowSamplers.count(s.first) > 0,
+                                      program->c_samplerTypes[s.first]);
+  }
+  for(const auto& s : program->c_storageImages){
+    ps->s_storageImages[s.first] = StorageImageData{s.second.bindno, nullptr};
+  }
+  for(const auto& s : program->c_storageBuffers){
+    ps->s_storageBuffers[s.first] = StorageBufferData{s.second.bindno, s.second.layout, nullptr};
   }
-  samplers_prepared = true;
+  for(const auto& s : program->c_inputAttachments){
+    ps->s_inputAttachments[s.first] = InputAttachmentData{s.second.bindno, s.second.index, nullptr};
+  }
+  ps->samplers_prepared = true;
 }
-void Pipeline::Impl::prepare_descset(){
-  if(descset_prepared) return;
-
+void Pipeline::Impl::recordUniformUpload(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer){
+  if(ps->b_dirtyBegin == ps->b_dirtyEnd) return;
+  Utils::recordUniformBufferUpdate(cmdBuffer, ps->b_uniformDeviceBuffer, ps->b_dirtyBegin,
+                                   ps->b_dirtyEnd - ps->b_dirtyBegin, ps->b_uniformHostBuffer + ps->b_dirtyBegin);
+  ps->b_dirtyBegin = ps->b_dirtyEnd = 0;
+}
+void Pipeline::Impl::acquire_descset(){
   prepare_unibuffers();
 
-  unsigned int samplerno = program->c_samplerBindings.size();
+  auto& allocator = global::descriptorAllocator;
+  if(ps->d_descriptorSet && !ps->d_descriptorSetDirty && allocator->isCurrent(ps->d_descriptorSetFrame))
+    return;
 
+  ps->d_descriptorSet = allocator->allocate(program->c_descriptorSetLayout, program->c_descriptorRequirements);
+  ps->d_descriptorSetFrame = allocator->getFrame();
+  ps->d_descriptorSetDirty = false;
 
-  // Descriptor bindings
-  std::vector<vkhlf::DescriptorSetLayoutBinding> dslbs;
-  dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, nullptr));
-  for(unsigned int i = 0; i < samplerno; i++)
-    dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(1 + i, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, nullptr));
-  // Descriptor set layout
-  d_descriptorSetLayout = global::device->createDescriptorSetLayout(dslbs);
+  write_descset(ps->d_descriptorSet, ps->b_uniformDeviceBuffer);
+}
 
-  // Set up descriptor sets
-  std::shared_ptr<vkhlf::DescriptorPool> descriptorPool = global::device->createDescriptorPool(
-    {}, 1 + samplerno,
-    {{vk::DescriptorType::eUniformBuffer, 1},
-        {vk::DescriptorType::eCombinedImageSampler, samplerno}});
+void Pipeline::Impl::acquire_ring_descset(){
+  prepare_unibuffers();
 
-  d_descriptorSet = global::device->allocateDescriptorSet(descriptorPool, d_descriptorSetLayout);
+  auto slice = global::uniformRing->allocate(ps->b_uniformSize);
+  memcpy(slice.data, ps->b_uniformHostBuffer, ps->b_uniformSize);
+  ps->b_dirtyBegin = ps->b_dirtyEnd = 0;
+  ps->b_uniformsInRing = true;
 
+  auto& allocator = global::descriptorAllocator;
+  ps->d_descriptorSet = allocator->allocate(program->c_descriptorSetLayout, program->c_descriptorRequirements);
+  ps->d_descriptorSetFrame = allocator->getFrame();
+  ps->d_descriptorSetDirty = false;
+
+  write_descset(ps->d_descriptorSet, slice.buffer, slice.offset);
+}
+
+void Pipeline::Impl::write_descset(std::shared_ptr<vkhlf::DescriptorSet> set, std::shared_ptr<vkhlf::Buffer> uniformBuffer,
+                                   vk::DeviceSize uniformOffset){
   std::vector<vkhlf::WriteDescriptorSet> wdss;
   wdss.push_back(vkhlf::WriteDescriptorSet(
-                   d_descriptorSet, 0, 0, 1,
+                   set, 0, 0, 1,
                    vk::DescriptorType::eUniformBuffer, nullptr,
-                   vkhlf::DescriptorBufferInfo(b_uniformDeviceBuffer, 0, b_uniformSize)));
-    global::device->updateDescriptorSets(wdss, nullptr);
-
-  descset_prepared = true;
+                   vkhlf::DescriptorBufferInfo(uniformBuffer, uniformOffset, ps->b_uniformSize)));
+  for(const auto& s : ps->s_samplers){
+    const auto& elements = s.second.elements;
+    // Unbound array elements must still hold a valid descriptor.
+    const SamplerData::Element* fallback = nullptr;
+    for(const auto& e : elements)
+      if(e.sampler){ fallback = &e; break; }
+    // Validation normally reports this earlier, but it may be skipped.
+    if(!fallback)
+      PipelineConfigError("SamplerNotSet", "This pipeline cannot render, sampler \"" + s.first + "\" was not bound to an image.").raise();
+    for(unsigned int i = 0; i < elements.size(); i++){
+      const auto& e = elements[i].sampler ? elements[i] : *fallback;
+      wdss.push_back(vkhlf::WriteDescriptorSet(
+                       set, s.second.bindno, i, 1,
+                       vk::DescriptorType::eCombinedImageSampler,
+                       vkhlf::DescriptorImageInfo(e.sampler, e.image->image_view, vk::ImageLayout::eShaderReadOnlyOptimal),
+                       nullptr
+                       ));
+    }
+  }
+  for(const auto& s : ps->s_storageImages){
+    wdss.push_back(vkhlf::WriteDescriptorSet(
+                     set, s.second.bindno, 0, 1,
+                     vk::DescriptorType::eStorageImage,
+                     vkhlf::DescriptorImageInfo(nullptr, s.second.image->image_view, vk::ImageLayout::eGeneral),
+                     nullptr
+                     ));
+  }
+  for(const auto& s : ps->s_storageBuffers){
+    wdss.push_back(vkhlf::WriteDescriptorSet(
+                     set, s.second.bindno, 0, 1,
+                     vk::DescriptorType::eStorageBuffer, nullptr,
+                     vkhlf::DescriptorBufferInfo(s.second.buffer->buffer, 0, s.second.buffer->getByteSize())));
+  }
+  for(const auto& s : ps->s_inputAttachments){
+    wdss.push_back(vkhlf::WriteDescriptorSet(
+                     set, s.second.bindno, 0, 1,
+                     vk::DescriptorType::eInputAttachment,
+                     vkhlf::DescriptorImageInfo(nullptr, s.second.image->getAttachmentView(), vk::ImageLayout::eShaderReadOnlyOptimal),
+                     nullptr
+                     ));
+  }
+  global::device->updateDescriptorSets(wdss, nullptr);
 }
 
 void Pipeline::Impl::prepare_renderpass(){
@@ -514,15 +1067,193 @@ void Pipeline::Impl::prepare_renderpass(){
 
   // Ensure all target images use the same extent.
   // Assume there is at least one image in target.
-  unsigned int width = targetImages[0]->getWidth();
-  unsigned int height = targetImages[0]->getHeight();
+  unsigned int width = getTargetSizeImage()->getWidth();
+  unsigned int height = getTargetSizeImage()->getHeight();
+  bool multisampled = (samples != vk::SampleCountFlagBits::e1);
   for(const auto& i: targetImages){
     if(i->getWidth() != width || i->getHeight() != height)
       PipelineConfigError("TargetImageSizeMismatch", "All target images must share identical dimensions.").raise();
+    // Integer formats cannot be resolved.
+    DataType dt = i->format.shaderDataType;
+    if(multisampled && dt != DataType::Float && dt != DataType::Float2 && dt != DataType::Float3 && dt != DataType::Float4)
+      PipelineConfigError("MultisampledIntegerTarget", "Multisampling can only be used with targets of NInt8 or Float format.").raise();
+  }
+  if(depthTarget){
+    if(depthTarget->getWidth() != width || depthTarget->getHeight() != height)
+      PipelineConfigError("TargetImageSizeMismatch", "All target images must share identical dimensions.").raise();
+    // Depth cannot be resolved.
+    if(multisampled)
+      PipelineConfigError("MultisampledDepthTarget", "Multisampling cannot be used when rendering onto a depth image.").raise();
   }
   rp_image_target_extent = vk::Extent2D(width, height);
 
+  // A layered framebuffer needs all attachments to have its layers.
+  unsigned int layers = getTargetSizeImage()->getLayers();
+  std::vector<std::shared_ptr<Image::Impl>> allTargets(targetImages);
+  if(depthTarget) allTargets.push_back(depthTarget);
+  for(const auto& i : allTargets){
+    if(targetLayer >= 0 && unsigned(targetLayer) >= i->getLayers())
+      PipelineConfigError("TargetLayerOutOfRange", "Target layer " + std::to_string(targetLayer) + " was selected, but a target image has " + std::to_string(i->getLayers()) + " layers.").raise();
+    if(targetLayer < 0 && i->getLayers() != layers)
+      PipelineConfigError("TargetLayerCountMismatch", "All target images must have the same number of layers when rendering onto all layers.").raise();
+  }
+  rp_image_target_layers = (targetLayer < 0) ? layers : 1;
+
+  // Prepare renderpass
+  rp_renderpass = getRenderPassVariant(0);
+
+  prepare_internal_attachments();
+
+  // Reuse a framebuffer made earlier for the same images. An entry whose
+  // images were destroyed may only match a new image at the same address.
+  std::pair<std::vector<const Image::Impl*>, int> fbKey;
+  for(const auto& i : targetImages) fbKey.first.push_back(i.get());
+  if(depthTarget) fbKey.first.push_back(depthTarget.get());
+  fbKey.second = targetLayer;
+  auto expired = [](const FramebufferData& fd){
+    for(const auto& w : fd.images)
+      if(w.expired()) return true;
+    return false;
+  };
+  auto it = rp_framebuffers.find(fbKey);
+  if(it != rp_framebuffers.end() && !expired(it->second)){
+    rp_framebuffer = it->second.framebuffer;
+    renderpass_prepared = true;
+    return;
+  }
+  for(auto jt = rp_framebuffers.begin(); jt != rp_framebuffers.end();){
+    if(expired(jt->second)) jt = rp_framebuffers.erase(jt);
+    else ++jt;
+  }
+
+  // Prepare imageviews for targets
+  std::vector<std::shared_ptr<vkhlf::ImageView>> iviews;
+  for(const auto& i : targetImages){
+    iviews.push_back(i->getTargetView(targetLayer));
+  }
+  // When multisampling, targets become resolve attachments.
+  std::vector<std::shared_ptr<vkhlf::ImageView>> resolveViews;
+  if(multisampled){
+    resolveViews.swap(iviews);
+    iviews = rp_msColorViews;
+  }
+  iviews.push_back(depthTarget ? depthTarget->getTargetView(targetLayer) : rp_depthview);
+  iviews.insert(iviews.end(), resolveViews.begin(), resolveViews.end());
+
+  // Prepare framebuffer
+  rp_framebuffer = global::device->createFramebuffer(rp_renderpass, iviews, rp_image_target_extent, rp_image_target_layers);
+  FramebufferData& fd = rp_framebuffers[fbKey];
+  fd.images.assign(targetImages.begin(), targetImages.end());
+  if(depthTarget) fd.images.push_back(depthTarget);
+  fd.framebuffer = rp_framebuffer;
+
+  renderpass_prepared = true;
+}
 
+void Pipeline::Impl::prepare_internal_attachments(){
+  InternalAttachmentsKey key;
+  for(const auto& i : targetImages) key.colorFormats.push_back(i->format.vkFormat);
+  key.depthFormat = depthFormat;
+  key.samples = samples;
+  // Overwritten contents are never stored, so these need no memory.
+  key.msTransient = (targetUsageHint == TargetUsageHint::Overwrite);
+  key.depthTransient = depthDiscarded();
+  key.hasDepthTarget = (depthTarget != nullptr);
+  key.width = rp_image_target_extent.width;
+  key.height = rp_image_target_extent.height;
+  key.layers = rp_image_target_layers;
+  if(rp_internalPrepared && key == rp_internalKey) return;
+  rp_internalKey = key;
+  rp_internalPrepared = true;
+
+  // Framebuffers use the previous attachments.
+  rp_framebuffers.clear();
+
+  // Layered framebuffers need layered internal attachments.
+  vk::ImageViewType viewType = (key.layers > 1) ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+
+  // Prepare multisampled color images.
+  rp_msColorImages.clear();
+  rp_msColorViews.clear();
+  if(samples != vk::SampleCountFlagBits::e1){
+    bool transient = key.msTransient;
+    for(const auto& i : targetImages){
+      auto msImage = global::device->createImage(
+        vk::ImageCreateFlags(),
+        vk::ImageType::e2D,
+        i->format.vkFormat,
+        vk::Extent3D(key.width, key.height, 1),
+        1,
+        key.layers,
+        samples,
+        vk::ImageTiling::eOptimal,
+        transient ? (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransientAttachment)
+                  : vk::ImageUsageFlags(vk::ImageUsageFlagBits::eColorAttachment),
+        vk::SharingMode::eExclusive,
+        std::vector<uint32_t>(), // queue family indices
+        vk::ImageLayout::eUndefined,
+        (transient && global::lazilyAllocatedMemory) ? vk::MemoryPropertyFlagBits::eLazilyAllocated
+                                                     : vk::MemoryPropertyFlagBits::eDeviceLocal,
+        nullptr, nullptr
+        );
+      rp_msColorImages.push_back(msImage);
+      rp_msColorViews.push_back(msImage->createImageView(viewType, i->format.vkFormat,
+                                                { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG,
+                                                  vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
+                                                { vk::ImageAspectFlagBits::eColor, 0, 1, 0, key.layers }));
+    }
+    rp_msPendingClear = true;
+  }
+  // Prepare the internal depth image
+  rp_depthimage = nullptr;
+  rp_depthview = nullptr;
+  if(!depthTarget){
+    // A discarded depth buffer never leaves the render pass, so it may not
+    // need any backing memory at all.
+    bool transient = depthDiscarded();
+    rp_depthimage = global::device->createImage(
+      vk::ImageCreateFlags(),
+      vk::ImageType::e2D,
+      depthFormat,
+      vk::Extent3D(key.width, key.height, 1),
+      1,
+      key.layers,
+      samples,
+      vk::ImageTiling::eOptimal,
+      transient ? (vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransientAttachment)
+                : vk::ImageUsageFlags(vk::ImageUsageFlagBits::eDepthStencilAttachment),
+      vk::SharingMode::eExclusive,
+      std::vector<uint32_t>(), // queue family indices
+      vk::ImageLayout::ePreinitialized,
+      (transient && global::lazilyAllocatedMemory) ? vk::MemoryPropertyFlagBits::eLazilyAllocated
+                                                   : vk::MemoryPropertyFlagBits::eDeviceLocal,
+      nullptr, nullptr
+      );
+    rp_depthview = rp_depthimage->createImageView(viewType, depthFormat,
+                                             { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG,
+                                               vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
+                                             { Utils::getDepthAspect(depthFormat), 0, 1, 0, key.layers });
+    // The new depth image will be cleared by the first render pass.
+    rp_depthPendingClear = true;
+  }
+}
+
+std::shared_ptr<vkhlf::RenderPass> Pipeline::Impl::getRenderPassVariant(uint32_t clearMask){
+  RenderPassKey key;
+  for(const auto& i : targetImages) key.colorFormats.push_back(i->format.vkFormat);
+  key.depthFormat = getDepthFormat();
+  key.samples = samples;
+  key.targetUsageHint = targetUsageHint;
+  key.depthDiscarded = depthDiscarded();
+  key.clearMask = clearMask;
+  auto it = rp_renderpassVariants.find(key);
+  if(it != rp_renderpassVariants.end()) return it->second;
+  auto rp = createRenderPass(clearMask);
+  rp_renderpassVariants[key] = rp;
+  return rp;
+}
+
+std::shared_ptr<vkhlf::RenderPass> Pipeline::Impl::createRenderPass(uint32_t clearMask){
   // Gather color attachment references.
   std::vector<vk::AttachmentReference> colorReferences;
   unsigned int n = 0;
@@ -534,118 +1265,120 @@ void Pipeline::Impl::prepare_renderpass(){
   n = targetImages.size();
   vk::AttachmentReference depthReference(n, vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
+  // Cleared attachments may start in any layout, loaded ones must already be
+  // in the attachment layout.
+  auto loaded = [&](unsigned int attachment){
+    if(clearMask & (1u << attachment)) return false;
+    if(attachment < n) return targetUsageHint != TargetUsageHint::Overwrite;
+    return !depthDiscarded();
+  };
+  auto loadOp = [&](unsigned int attachment){
+    if(clearMask & (1u << attachment)) return vk::AttachmentLoadOp::eClear;
+    return loaded(attachment) ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eDontCare;
+  };
+  auto initialLayout = [&](unsigned int attachment, vk::ImageLayout l){
+    return loaded(attachment) ? l : vk::ImageLayout::eUndefined;
+  };
+  vk::AttachmentStoreOp depthStoreOp = depthDiscarded() ?
+    vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
+  // Multisampled color is only needed by subsequent draws, results are kept
+  // in the resolved targets.
+  bool multisampled = (samples != vk::SampleCountFlagBits::e1);
+  vk::AttachmentStoreOp colorStoreOp = (multisampled && targetUsageHint == TargetUsageHint::Overwrite) ?
+    vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
+
   // Gather attachment descriptions.
   std::vector<vk::AttachmentDescription> attachmentDescriptions;
-  for(const auto& i : targetImages){
+  for(unsigned int i = 0; i < n; i++){
     attachmentDescriptions.push_back(vk::AttachmentDescription(
-                                       {}, i->format.vkFormat, vk::SampleCountFlagBits::e1,
-                                       vk::AttachmentLoadOp::eLoad, vk::AttachmentStoreOp::eStore, // color
+                                       {}, targetImages[i]->format.vkFormat, samples,
+                                       loadOp(i), colorStoreOp, // color
                                        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
-                                       vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal
+                                       initialLayout(i, vk::ImageLayout::eColorAttachmentOptimal), vk::ImageLayout::eColorAttachmentOptimal
                                        ));
   }
   attachmentDescriptions.push_back(vk::AttachmentDescription(
-                                     {}, vk::Format::eD32Sfloat, vk::SampleCountFlagBits::e1,
-                                     vk::AttachmentLoadOp::eLoad, vk::AttachmentStoreOp::eStore, // depth
+                                     {}, getDepthFormat(), samples,
+                                     loadOp(n), depthStoreOp, // depth
                                      vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
-                                     vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal
+                                     initialLayout(n, vk::ImageLayout::eDepthStencilAttachmentOptimal), vk::ImageLayout::eDepthStencilAttachmentOptimal
                                      ));
+  // Target images are resolve attachments, fully overwritten on each pass.
+  std::vector<vk::AttachmentReference> resolveReferences;
+  if(multisampled){
+    for(unsigned int i = 0; i < n; i++){
+      resolveReferences.push_back(vk::AttachmentReference(n + 1 + i, vk::ImageLayout::eColorAttachmentOptimal));
+      attachmentDescriptions.push_back(vk::AttachmentDescription(
+                                         {}, targetImages[i]->format.vkFormat, vk::SampleCountFlagBits::e1,
+                                         vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eStore, // resolve
+                                         vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
+                                         vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal
+                                         ));
+    }
+  }
 
   vk::SubpassDescription subpassDesc(
     {}, vk::PipelineBindPoint::eGraphics, 0, nullptr,
     colorReferences.size(), colorReferences.data(),
-    nullptr,
+    multisampled ? resolveReferences.data() : nullptr,
     &depthReference,
     0, nullptr
     );
 
-  // Prepare renderpass
-  rp_renderpass = global::device->createRenderPass(attachmentDescriptions, subpassDesc, nullptr);
-
-  // Prepare imageviews for targets
-  std::vector<std::shared_ptr<vkhlf::ImageView>> iviews;
-  for(const auto& i : targetImages){
-    // TODO: Consider image format
-    auto iv = i->image->createImageView(vk::ImageViewType::e2D, i->format.vkFormat,
-                                            { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG,
-                                              vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
-                                            { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
-    iviews.push_back(iv);
-  }
-  // Prepare imageviews for depth
-  if(depthTarget){
-    //rp_depthtarget = depthTarget;
-  }else{
-    rp_depthimage = global::device->createImage(
-      vk::ImageCreateFlags(),
-      vk::ImageType::e2D,
-      vk::Format::eD32Sfloat,
-      vk::Extent3D(width, height, 1),
-      1,
-      1,
-      vk::SampleCountFlagBits::e1,
-      vk::ImageTiling::eOptimal,
-      vk::ImageUsageFlagBits::eDepthStencilAttachment,
-      vk::SharingMode::eExclusive,
-      std::vector<uint32_t>(), // queue family indices
-      vk::ImageLayout::ePreinitialized,
-      vk::MemoryPropertyFlagBits::eDeviceLocal,
-      nullptr, nullptr
-      );
-  }
-  auto iv = rp_depthimage->createImageView(vk::ImageViewType::e2D, vk::Format::eD32Sfloat,
-                                         { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG,
-                                           vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
-                                         { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 });
-  iviews.push_back(iv);
-
-  clearDepthImage();
-
-  // Prepare framebuffer
-  rp_framebuffer = global::device->createFramebuffer(rp_renderpass, iviews, rp_image_target_extent, 1);
-
-  renderpass_prepared = true;
+  return global::device->createRenderPass(attachmentDescriptions, subpassDesc, nullptr);
 }
 
-void Pipeline::Impl::clearDepthImage(){
-  // Clear depth image.
-  Scheduler::buildAndSubmitSynced("Clearing depth image", [&](std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer){
-      auto image = rp_depthimage;
-      vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eDepth,
-        vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-      cmdBuffer->clearDepthStencilImage(image, vk::ImageLayout::eTransferDstOptimal, 1.0f, 0, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1));
-      vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eDepth,
-        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal);
-    });
+Pipeline::Impl::StateKey Pipeline::Impl::getStateKey() const{
+  return StateKey{faceCullMode, faceDirection, polygonMode, rasterizerMode, line_width,
+                  blendFactorColorSrc, blendFactorColorDst, blendFactorAlphaSrc, blendFactorAlphaDst,
+                  blendOperationColor, blendOperationAlpha, depthTest, depthWrite, depthCompare};
 }
 
 void Pipeline::Impl::cook(){
+    // Window render passes are recreated when its settings change.
+    if(target_is_window && c_windowRenderPass != targetWindow->renderPass){
+      if(c_windowRenderPass) clearPipelineVariants(c_windowRenderPass);
+      c_windowRenderPass = targetWindow->renderPass;
+      cooked = false;
+    }
+    // Pipelines are built for the render pass of a recording chain instead
+    // of the pipeline's own one.
+    auto chainRenderPass = isChainRecording() ? chain->c_renderPass : nullptr;
+    if(c_chainRenderPass != chainRenderPass){
+      c_chainRenderPass = chainRenderPass;
+      cooked = false;
+    }
     if(cooked) return;
 
-    // Prepare vkPipeline etc.
-    out_dbg("Cooking a pipeline.");
-
     prepare_unibuffers();
 
     prepare_samplers();
 
-    prepare_descset();
-
-    // pipeline layout
-    c_pipelineLayout = global::device->createPipelineLayout(d_descriptorSetLayout, nullptr);
-
     // Take renderpass and framebuffer
     if(target_is_window){
       c_renderPass = targetWindow->renderPass;
     }else{
       prepare_renderpass();
-      c_renderPass = rp_renderpass;
+      c_renderPass = c_chainRenderPass ? c_chainRenderPass : rp_renderpass;
+    }
+
+    // Reuse a pipeline built earlier for the same state, if there is one.
+    StateKey key = getStateKey();
+    auto& variants = ps->c_pipelineVariants[c_renderPass];
+    auto it = variants.find(key);
+    if(it != variants.end()){
+      c_pipeline = it->second;
+    }else{
+      c_pipeline = createVkPipeline();
+      variants[key] = c_pipeline;
     }
 
-    // init pipeline
-    std::shared_ptr<vkhlf::PipelineCache> pipelineCache = global::device->createPipelineCache(0, nullptr);
+    cooked = true;
+}
+
+std::shared_ptr<vkhlf::Pipeline> Pipeline::Impl::createVkPipeline(){
+    // Prepare vkPipeline etc.
+    out_dbg("Cooking a pipeline.");
 
     // Use shaders
     vkhlf::PipelineShaderStageCreateInfo vertexStage(
@@ -717,11 +1450,11 @@ void Pipeline::Impl::cook(){
       // TODO: Ensure the device supports ` wideLines`.
       line_width);
     vkhlf::PipelineMultisampleStateCreateInfo multisample(
-      vk::SampleCountFlagBits::e1, false, 0.0f, nullptr, false, false);
+      target_is_window ? targetWindow->samples : samples, false, 0.0f, nullptr, false, false);
     vk::StencilOpState stencilOpState(
       vk::StencilOp::eKeep, vk::StencilOp::eKeep, vk::StencilOp::eKeep, vk::CompareOp::eAlways, 0, 0, 0);
     vk::PipelineDepthStencilStateCreateInfo depthStencil(
-      {}, true, true, vk::CompareOp::eLessOrEqual, false, false, stencilOpState, stencilOpState, 0.0f, 0.0f);
+      {}, depthTest, depthWrite, compareOpSGA2VK(depthCompare), false, false, stencilOpState, stencilOpState, 0.0f, 0.0f);
 
     vk::PipelineColorBlendAttachmentState defaultColorBlendAttachment(
       true,
@@ -748,8 +1481,8 @@ void Pipeline::Impl::cook(){
     vkhlf::PipelineDynamicStateCreateInfo dynamic(
       { vk::DynamicState::eViewport, vk::DynamicState::eScissor });
 
-    c_pipeline = global::device->createGraphicsPipeline(
-      pipelineCache,
+    return global::device->createGraphicsPipeline(
+      global::pipelineCache,
       {},
       { vertexStage, fragmentStage },
       vertexInput,
@@ -761,14 +1494,15 @@ void Pipeline::Impl::cook(){
       depthStencil,
       colorBlend,
       dynamic,
-      c_pipelineLayout,
-      c_renderPass);
-
-    cooked = true;
+      program->c_pipelineLayout,
+      c_renderPass,
+      c_chainRenderPass ? chainSubpass : 0);
 }
 
 FullQuadPipeline::Impl::Impl() :
   vbo({sga::DataType::Float2}, 3){
+  // A single triangle never needs depth from previous draws.
+  depthUsageHint = TargetUsageHint::Discard;
   std::vector<std::array<float,2>> vertices = {{-1,-1},{ 3,-1},{-1, 3}};
   vbo.write(vertices);
 }
@@ -783,7 +1517,8 @@ void FullQuadPipeline::Impl::setProgram(const Program& p_){
 
   program = p;
   cooked = false;
-  samplers_prepared = descset_prepared = unibuffers_prepared = false;
+  validated = false;
+  switchProgramState(p);
 }
 
 void FullQuadPipeline::Impl::drawFullQuad(){
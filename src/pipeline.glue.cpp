@@ -1,5 +1,6 @@
 #include <sga/pipeline.hpp>
 #include "pipeline.impl.hpp"
+#include "query.impl.hpp"
 
 namespace sga {
 
@@ -29,6 +30,10 @@ void Pipeline::drawIndexed(const VBO& vbo, const IBO& ibo) {
   impl()->drawIndexed(vbo, ibo);
 }
 
+void Pipeline::drawProcedural(unsigned int n) {
+  impl()->drawProcedural(n);
+}
+
 void Pipeline::clear() {
   impl()->clear();
 }
@@ -37,17 +42,38 @@ void Pipeline::setProgram(const Program& p) {
   impl()->setProgram(p);
 }
 
-void Pipeline::setUniform(std::string name, std::initializer_list<float> floats){
+void Pipeline::setUniform(const std::string& name, std::initializer_list<float> floats){
   impl()->setUniform(name, floats);
 }
-void Pipeline::setUniform(DataType dt, std::string name, char* pData, size_t size){
+void Pipeline::setUniform(DataType dt, const std::string& name, char* pData, size_t size){
   impl()->setUniform(dt, name, pData, size);
 }
+void Pipeline::setUniform(DataType dt, const UniformHandle& handle, char* pData, size_t size){
+  impl()->setUniform(dt, handle.program, handle.offset, handle.type, handle.index, pData, size);
+}
+
+UniformHandle Pipeline::getUniformHandle(const std::string& name){
+  UniformHandle h;
+  impl()->getUniformHandle(name, h.program, h.offset, h.type, h.index);
+  return h;
+}
 
 void Pipeline::setSampler(std::string s, const Image& i,
                           SamplerInterpolation in, SamplerWarpMode wm){
   impl()->setSampler(s,i,in,wm);
 }
+void Pipeline::setSampler(std::string s, unsigned int index, const Image& i,
+                          SamplerInterpolation in, SamplerWarpMode wm){
+  impl()->setSampler(s,index,i,in,wm);
+}
+
+void Pipeline::setStorageBuffer(std::string s, const StorageBuffer& b){
+  impl()->setStorageBuffer(s, b);
+}
+
+void Pipeline::setInputAttachment(std::string s, const Image& i){
+  impl()->setInputAttachment(s, i);
+}
 
 void Pipeline::setFaceCull(FaceCullMode fcm, FaceDirection fd){
   impl()->setFaceCull(fcm,fd);
@@ -72,6 +98,56 @@ void Pipeline::setBlendModeAlpha(BlendFactor src, BlendFactor dst, BlendOperatio
   impl()->setBlendModeAlpha(src,dst,op);
 }
 
+void Pipeline::setDepthTest(bool enabled){
+  impl()->setDepthTest(enabled);
+}
+void Pipeline::setDepthWrite(bool enabled){
+  impl()->setDepthWrite(enabled);
+}
+void Pipeline::setDepthCompare(CompareOp op){
+  impl()->setDepthCompare(op);
+}
+void Pipeline::setDepthFormat(DepthFormat format){
+  impl()->setDepthFormat(format);
+}
+void Pipeline::setDepthClearValue(float value){
+  impl()->setDepthClearValue(value);
+}
+void Pipeline::setReverseZ(bool enabled){
+  impl()->setReverseZ(enabled);
+}
+
+void Pipeline::setTargetLayer(unsigned int layer){
+  impl()->setTargetLayer(layer);
+}
+void Pipeline::setTargetAllLayers(){
+  impl()->setTargetAllLayers();
+}
+
+void Pipeline::setTargetUsageHint(TargetUsageHint hint){
+  impl()->setTargetUsageHint(hint);
+}
+void Pipeline::setDepthUsageHint(TargetUsageHint hint){
+  impl()->setDepthUsageHint(hint);
+}
+
+void Pipeline::setMultisampling(unsigned int samples){
+  impl()->setMultisampling(samples);
+}
+
+void Pipeline::setOcclusionQuery(const OcclusionQuery& query){
+  impl()->setOcclusionQuery(query.impl);
+}
+void Pipeline::resetOcclusionQuery(){
+  impl()->setOcclusionQuery(nullptr);
+}
+void Pipeline::setDrawCondition(const OcclusionQuery& query){
+  impl()->setDrawCondition(query.impl);
+}
+void Pipeline::resetDrawCondition(){
+  impl()->setDrawCondition(nullptr);
+}
+
 void Pipeline::resetViewport(){
   impl()->resetViewport();
 }
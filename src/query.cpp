@@ -0,0 +1,70 @@
+#include "query.impl.hpp"
+
+#include "global.hpp"
+#include "scheduler.hpp"
+
+namespace sga{
+
+OcclusionQuery::Impl::Impl(){
+  pool = global::device->createQueryPool(
+    vk::QueryPoolCreateFlags(), vk::QueryType::eOcclusion, slotCount,
+    vk::QueryPipelineStatisticFlags(), nullptr);
+}
+
+void OcclusionQuery::Impl::poll(){
+  while(!pending.empty() && pending.front().syncCount < Scheduler::getSyncCount()){
+    uint64_t result;
+    vk::Result r = static_cast<vk::Device>(*global::device).getQueryPoolResults(
+      static_cast<vk::QueryPool>(*pool), pending.front().slot, 1,
+      sizeof(result), &result, sizeof(result), vk::QueryResultFlagBits::e64);
+    // Queries finish in order, no point in checking newer ones.
+    if(r != vk::Result::eSuccess) break;
+    samplesPassed = result;
+    resultAvailable = true;
+    pending.pop_front();
+  }
+}
+
+bool OcclusionQuery::Impl::isResultAvailable(){
+  poll();
+  return resultAvailable;
+}
+
+uint64_t OcclusionQuery::Impl::getSamplesPassed(){
+  poll();
+  return samplesPassed;
+}
+
+bool OcclusionQuery::Impl::isVisible(){
+  poll();
+  return !resultAvailable || samplesPassed > 0;
+}
+
+uint32_t OcclusionQuery::Impl::prepareSlot(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer){
+  poll();
+  // If all slots await results, the oldest one is abandoned, as its result
+  // would be immediately replaced by a newer one anyway.
+  if(pending.size() == slotCount) pending.pop_front();
+  uint32_t slot = nextSlot;
+  nextSlot = (nextSlot + 1) % slotCount;
+  pending.push_back({slot, Scheduler::getSyncCount()});
+  cmdBuffer->resetQueryPool(pool, slot, 1);
+  // The pool must stay alive while queries are in flight.
+  Scheduler::appendChainedResource(pool);
+  return slot;
+}
+
+void OcclusionQuery::Impl::begin(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer, uint32_t slot){
+  // Without precise queries, the result is only guaranteed to be non-zero if
+  // any samples passed.
+  vk::QueryControlFlags flags;
+  if(global::deviceFeatures.occlusionQueryPrecise)
+    flags = vk::QueryControlFlagBits::ePrecise;
+  cmdBuffer->beginQuery(pool, slot, flags);
+}
+
+void OcclusionQuery::Impl::end(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer, uint32_t slot){
+  cmdBuffer->endQuery(pool, slot);
+}
+
+} // namespace sga
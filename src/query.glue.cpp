@@ -0,0 +1,24 @@
+#include <sga/query.hpp>
+#include "query.impl.hpp"
+
+namespace sga {
+
+OcclusionQuery::OcclusionQuery()
+  : impl(std::make_shared<OcclusionQuery::Impl>()) {
+}
+
+OcclusionQuery::~OcclusionQuery() = default;
+
+bool OcclusionQuery::isResultAvailable(){
+  return impl->isResultAvailable();
+}
+
+uint64_t OcclusionQuery::getSamplesPassed(){
+  return impl->getSamplesPassed();
+}
+
+bool OcclusionQuery::isVisible(){
+  return impl->isVisible();
+}
+
+} // namespace sga
@@ -18,6 +18,8 @@ std::shared_ptr<vkhlf::Semaphore> Scheduler::last_chain_semaphore = nullptr;
 
 std::shared_ptr<vkhlf::CommandBuffer> Scheduler::current_command_buffer = nullptr;
 
+uint64_t Scheduler::sync_count = 0;
+
 void Scheduler::initQueue(unsigned int queueFamilyIndex){
   queue = global::device->getQueue(queueFamilyIndex, 0);
 }
@@ -87,6 +89,7 @@ void Scheduler::sync(){
     last_chain_semaphore = nullptr;
   }
   references_till_next_sync.clear();
+  sync_count++;
 }
 
 void Scheduler::borrowChainableCmdBuffer(const char* annotation, std::function<void(std::shared_ptr<vkhlf::CommandBuffer>)> action){
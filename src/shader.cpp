@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <regex>
+#include <algorithm>
 
 #include <vkhlf/vkhlf.h>
 #include <glslang/SPIRV/GlslangToSpv.h>
@@ -11,16 +12,25 @@
 #include "global.hpp"
 #include "layout.hpp"
 #include "utils.hpp"
+#include "frame.hpp"
+#include "image.impl.hpp"
 
 namespace sga{
 
 Shader::Impl::Impl() {}
 
+// Returns the prefix of GLSL image types (e.g. "i" in iimage2D) for images
+// which hold values of the given type.
+static std::string getImageTypePrefix(DataType dt){
+  if(dt == DataType::SInt || dt == DataType::SInt2 || dt == DataType::SInt3 || dt == DataType::SInt4) return "i";
+  if(dt == DataType::UInt || dt == DataType::UInt2 || dt == DataType::UInt3 || dt == DataType::UInt4) return "u";
+  return "";
+}
+
 VertexShader VertexShader::createFromSource(std::string source){
   VertexShader s;
   s.impl->stage = vk::ShaderStageFlagBits::eVertex;
   s.impl->source = source;
-  s.impl->addStandardUniforms();
   return s;
 }
 VertexShader VertexShader::createFromFile(std::string path){
@@ -31,13 +41,22 @@ FragmentShader FragmentShader::createFromSource(std::string source){
   FragmentShader s;
   s.impl->stage = vk::ShaderStageFlagBits::eFragment;
   s.impl->source = source;
-  s.impl->addStandardUniforms();
   return s;
 }
 FragmentShader FragmentShader::createFromFile(std::string path){
   return createFromSource(Utils::readEntireFile(path));
 }
 
+ComputeShader ComputeShader::createFromSource(std::string source){
+  ComputeShader s;
+  s.impl->stage = vk::ShaderStageFlagBits::eCompute;
+  s.impl->source = source;
+  return s;
+}
+ComputeShader ComputeShader::createFromFile(std::string path){
+  return createFromSource(Utils::readEntireFile(path));
+}
+
 void Shader::Impl::addInput(DataType type, std::string name) {
   addInput(std::make_pair(type,name));
 }
@@ -62,23 +81,70 @@ void Shader::Impl::addOutput(std::pair<DataType, std::string> pair) {
   outputAttr.push_back({pair.first, pair.second, ""});
 }
 
-void Shader::Impl::addUniform(sga::DataType type, std::string name, bool special){
-  if(!special && name.substr(0,3) == "sga")
+void Shader::Impl::addUniform(sga::DataType type, std::string name){
+  if(name.substr(0,3) == "sga")
     ProgramConfigError("UniformNameReserved", "Cannot add an uniform using a reserved name", "Uniforms with names beginning with `sga` have a special meaning, and you cannot declare your own").raise();
   if(!isVariableNameValid(name))
     ProgramConfigError("UniformNameInvalid", "Cannot use \"" + name + "\" for the identifier of a uniform, it must be a valid C indentifier.").raise();
   uniforms.push_back({type,name,""});
 }
-void Shader::Impl::addSampler(std::string name){
+void Shader::Impl::addSampler(std::string name, ImageType type){
   if(!isVariableNameValid(name))
     ProgramConfigError("SamplerNameInvalid", "Cannot use \"" + name + "\" for the identifier of a sampler, it must be a valid C indentifier.").raise();
-  samplers.push_back(name);
+  samplers.push_back({name, 0, false, type});
+}
+void Shader::Impl::addSamplerArray(std::string name, unsigned int size){
+  if(!isVariableNameValid(name))
+    ProgramConfigError("SamplerNameInvalid", "Cannot use \"" + name + "\" for the identifier of a sampler, it must be a valid C indentifier.").raise();
+  if(size == 0)
+    ProgramConfigError("SamplerArrayEmpty", "Sampler array \"" + name + "\" must have at least one element.").raise();
+  samplers.push_back({name, size});
+}
+void Shader::Impl::addShadowSampler(std::string name, ImageType type){
+  if(!isVariableNameValid(name))
+    ProgramConfigError("SamplerNameInvalid", "Cannot use \"" + name + "\" for the identifier of a sampler, it must be a valid C indentifier.").raise();
+  samplers.push_back({name, 0, true, type});
+}
+
+void Shader::Impl::addStorageImage(std::string name, unsigned int channels, ImageFormat format){
+  if(!isVariableNameValid(name))
+    ProgramConfigError("StorageImageNameInvalid", "Cannot use \"" + name + "\" for the identifier of a storage image, it must be a valid C indentifier.").raise();
+  if(channels == 0 || channels > 4)
+    ProgramConfigError("StorageImageChannels", "Storage image \"" + name + "\" must have between one and four channels.").raise();
+  // Raises an error for formats that cannot be used for storage.
+  getStorageFormatQualifier(channels, format);
+  storageImages.push_back({name, channels, format});
+}
+
+void Shader::Impl::addStorageBuffer(std::string name, std::vector<std::pair<DataType, std::string>> fields, bool readOnly){
+  if(!isVariableNameValid(name))
+    ProgramConfigError("StorageBufferNameInvalid", "Cannot use \"" + name + "\" for the identifier of a storage buffer, it must be a valid C indentifier.").raise();
+  if(fields.empty())
+    ProgramConfigError("StorageBufferEmpty", "Storage buffer \"" + name + "\" must have at least one field.").raise();
+  bool singleValue = fields.size() == 1 && fields[0].second == "";
+  if(!singleValue)
+    for(const auto& f : fields)
+      if(!isVariableNameValid(f.second))
+        ProgramConfigError("StorageBufferFieldInvalid", "Cannot use \"" + f.second + "\" for the identifier of a field of storage buffer \"" + name + "\", it must be a valid C indentifier.").raise();
+  storageBuffers.push_back({name, fields, readOnly});
 }
 
-void Shader::Impl::addStandardUniforms(){
-  addUniform(DataType::Float, "sgaTime", true);
-  addUniform(DataType::Float2, "sgaResolution", true);
-  addUniform(DataType::Float4, "sgaViewport", true);
+void Shader::Impl::addInputAttachment(std::string name, ImageFormat format){
+  if(!isVariableNameValid(name))
+    ProgramConfigError("InputAttachmentNameInvalid", "Cannot use \"" + name + "\" for the identifier of an input attachment, it must be a valid C indentifier.").raise();
+  if(format == ImageFormat::Depth || format == ImageFormat::Depth16)
+    ProgramConfigError("InputAttachmentFormat", "Input attachment \"" + name + "\" cannot use a depth format.").raise();
+  inputAttachments.push_back({name, format});
+}
+
+void Shader::Impl::setWorkGroupSize(unsigned int x, unsigned int y, unsigned int z){
+  const auto& limits = global::deviceLimits;
+  if(x == 0 || y == 0 || z == 0)
+    ProgramConfigError("InvalidWorkGroupSize", "Work group size must be at least 1 in each dimension.").raise();
+  if(x > limits.maxComputeWorkGroupSize[0] || y > limits.maxComputeWorkGroupSize[1] ||
+     z > limits.maxComputeWorkGroupSize[2] || x * y * z > limits.maxComputeWorkGroupInvocations)
+    ProgramConfigError("InvalidWorkGroupSize", "The device does not support work groups of size " + std::to_string(x) + "x" + std::to_string(y) + "x" + std::to_string(z) + ", at most " + std::to_string(limits.maxComputeWorkGroupInvocations) + " invocations per group are supported.").raise();
+  workGroupSize = {{x, y, z}};
 }
 
 void Shader::Impl::setOutputInterpolationMode(std::string name, sga::OutputInterpolationMode mode){
@@ -114,6 +180,8 @@ void Program::Impl::setVertexShader(VertexShader vs_) {
   auto vs = vs_.impl;
   if(compiled)
     ProgramConfigError("AlreadyCompiled", "This program has already been compiled, you cannot change shaders anymore.").raise();
+  if(CS.source != "")
+    ProgramConfigError("AlreadyHasCS", "This program has a compute shader, it cannot have other shaders.").raise();
   if(VS.source != "")
     ProgramConfigError("AlreadyHasVS", "This program already has a vertex shader, you cannot set another.").raise();
   if(!vs || vs->source == "")
@@ -124,11 +192,14 @@ void Program::Impl::setVertexShader(VertexShader vs_) {
   VS.outputAttr = vs->outputAttr;
   VS.uniforms = vs->uniforms;
   VS.samplers = vs->samplers;
+  VS.storageBuffers = vs->storageBuffers;
 }
 void Program::Impl::setFragmentShader(FragmentShader fs_) {
   auto fs = fs_.impl;
   if(compiled)
     ProgramConfigError("AlreadyCompiled", "This program has already been compiled, you cannot change shaders anymore").raise();
+  if(CS.source != "")
+    ProgramConfigError("AlreadyHasCS", "This program has a compute shader, it cannot have other shaders.").raise();
   if(FS.source != "")
     ProgramConfigError("AlreadyHasFS", "This program already has a fragment shader, you cannot set another.").raise();
   if(!fs || fs->source == "")
@@ -139,9 +210,42 @@ void Program::Impl::setFragmentShader(FragmentShader fs_) {
   FS.outputAttr = fs->outputAttr;
   FS.uniforms = fs->uniforms;
   FS.samplers = fs->samplers;
+  FS.storageBuffers = fs->storageBuffers;
+  FS.inputAttachments = fs->inputAttachments;
+}
+void Program::Impl::setComputeShader(ComputeShader cs_) {
+  auto cs = cs_.impl;
+  if(compiled)
+    ProgramConfigError("AlreadyCompiled", "This program has already been compiled, you cannot change shaders anymore").raise();
+  if(CS.source != "")
+    ProgramConfigError("AlreadyHasCS", "This program already has a compute shader, you cannot set another.").raise();
+  if(VS.source != "" || FS.source != "")
+    ProgramConfigError("AlreadyHasShaders", "This program already has vertex or fragment shaders, it cannot have a compute shader.").raise();
+  if(!cs || cs->source == "")
+    ProgramConfigError("EmptyShader", "The provided shader is empty.").raise();
+  if(!cs->inputAttr.empty() || !cs->outputAttr.empty())
+    ProgramConfigError("ComputeShaderAttributes", "Compute shaders cannot have inputs or outputs.").raise();
+
+  CS.source = cs->source;
+  CS.uniforms = cs->uniforms;
+  CS.samplers = cs->samplers;
+  CS.storageImages = cs->storageImages;
+  CS.storageBuffers = cs->storageBuffers;
+  workGroupSize = cs->workGroupSize;
+}
+
+std::vector<std::reference_wrapper<Program::Impl::ShaderData>> Program::Impl::getStages(){
+  if(isCompute) return {std::ref(CS)};
+  return {std::ref(FS), std::ref(VS)};
 }
 
 void Program::Impl::compile() {
+  if(CS.source != ""){
+    isFullQuad = false;
+    isCompute = true;
+    compile_internal();
+    return;
+  }
   if(VS.source == "" || FS.source == "")
     ProgramConfigError("MissingShader", "A program must have both vertex and fragment shaders set before compiling!").raise();
 
@@ -170,7 +274,7 @@ void Program::Impl::compileFullQuad(){
 void Program::Impl::compile_internal() {
 
   out_dbg("Compiling program");
-  if(VS.source == "" || FS.source == "")
+  if(!isCompute && (VS.source == "" || FS.source == ""))
     ProgramConfigError("MissingShader", "A program must have both vertex and fragment shaders set before compiling!").raise();
 
   if(compiled)
@@ -178,10 +282,15 @@ void Program::Impl::compile_internal() {
   
   // Prepare preamble.
   std::string preamble = "#version 420\n";
+  // Vertex shaders may select the layer of layered targets. Without the
+  // extension, the compiler reports any use of gl_Layer in them.
+  std::string vertexPreamble;
+  if(global::vertexShaderLayer)
+    vertexPreamble = "#extension GL_ARB_shader_viewport_layer_array : enable\n";
 
   // Gather uniforms.
   std::map<std::string, DataType> uniforms;
-  for(const ShaderData& S : {std::ref(FS), std::ref(VS)}){
+  for(const ShaderData& S : getStages()){
     for(const auto& p : S.uniforms){
       auto it = uniforms.find(p.name);
       if(it == uniforms.end()){
@@ -193,41 +302,182 @@ void Program::Impl::compile_internal() {
     }
   }
 
+  auto& frameUniforms = global::frameUniforms;
+  for(const auto& p : uniforms)
+    if(frameUniforms->hasUniform(p.first))
+      ProgramConfigError("UniformNameConflict", "Uniform \"" + p.first + "\" has the same name as a frame uniform.").raise();
+
   // Prepare uniform layout.
   size_t offset = 0;
   std::string uniformCode = "layout(std140, binding = 0) uniform sga_uniforms {\n";
   for(const auto& p : uniforms){
     offset = align(offset, getDataTypeGLSLstd140Alignment(p.second));
-    c_uniformOffsets[p.first] = std::make_pair(offset, p.second);
+    // Taken before inserting, so that indices start at 0.
+    unsigned int index = c_uniforms.size();
+    c_uniforms[p.first] = UniformData{offset, p.second, index};
     uniformCode += "  " + getDataTypeGLSLName(p.second) + " sgaUniform_" + p.first + ";\n";
     offset += getDataTypeSize(p.second);
   }
+  // A block cannot be empty.
+  if(uniforms.empty()){
+    uniformCode += "  float sgaUnused;\n";
+    offset = getDataTypeSize(DataType::Float);
+  }
   uniformCode += "} u;\n\n";
   c_uniformSize = offset;
 
+  /* Standard uniforms which depend on the target are push constants, which
+   * is cheaper than a buffer update on each draw. The remaining ones are frame
+   * uniforms. */
+  if(!isCompute)
+    uniformCode += R"(layout(push_constant) uniform sga_standard {
+  vec4 viewport;
+  vec2 resolution;
+} sgaStandard;
+#define sgaViewport sgaStandard.viewport
+#define sgaResolution sgaStandard.resolution
+)";
+  uniformCode += frameUniforms->getCode();
+
   // Prepare uniform macros
   for(const auto& p : uniforms){
     uniformCode += "#define " + p.first + " u.sgaUniform_" + p.first + "\n";
   }
 
   // Prepare samplers.
-  std::set<std::string> sampler_names;
-  for(const ShaderData& S : {std::ref(FS), std::ref(VS)})
-    for(const auto& p : S.samplers)
-      sampler_names.insert(p);
-  
+  std::map<std::string, unsigned int> sampler_sizes;
+  std::set<std::string> shadow_samplers;
+  for(const ShaderData& S : getStages()){
+    for(const auto& p : S.samplers){
+      auto it = sampler_sizes.find(p.name);
+      if(it == sampler_sizes.end()){
+        sampler_sizes[p.name] = p.arraySize;
+        if(p.shadow) shadow_samplers.insert(p.name);
+        c_samplerTypes[p.name] = p.type;
+      }else{
+        if(c_samplerTypes[p.name] != p.type)
+          ProgramConfigError("SamplerMismatch", "Sampler \"" + p.name + "\" is declared with different image types in vertex and fragment shaders.").raise();
+        if(it->second != p.arraySize)
+          ProgramConfigError("SamplerMismatch", "Sampler \"" + p.name + "\" is declared with different array sizes in vertex and fragment shaders.").raise();
+        if(shadow_samplers.count(p.name) != (p.shadow ? 1u : 0u))
+          ProgramConfigError("SamplerMismatch", "Sampler \"" + p.name + "\" is declared as a shadow sampler in only one of vertex and fragment shaders.").raise();
+      }
+    }
+  }
+
+  // Indexing sampler arrays with non-constant values is an optional feature.
+  if(!global::deviceFeatures.shaderSampledImageArrayDynamicIndexing)
+    for(const auto& p : sampler_sizes)
+      if(p.second > 0)
+        ProgramConfigError("SamplerArrayUnsupported", "Cannot use sampler array \"" + p.first + "\", this device does not support indexing sampler arrays.").raise();
+
+  // Ensure the device can bind that many images at once.
+  unsigned int sampler_descriptors = 0;
+  for(const auto& p : sampler_sizes)
+    sampler_descriptors += std::max(1u, p.second);
+  if(sampler_descriptors > global::deviceLimits.maxPerStageDescriptorSamplers)
+    ProgramConfigError("TooManySamplers", "This program uses " + std::to_string(sampler_descriptors) + " sampled images, but the device supports at most " + std::to_string(global::deviceLimits.maxPerStageDescriptorSamplers) + " per shader.").raise();
+
   // Prepare sampler bindings.
   unsigned int bindno = 1; // binding 0 is used for UBO
-  for(const auto& name : sampler_names)
-    c_samplerBindings[name] = bindno++;
+  for(const auto& p : sampler_sizes){
+    c_samplerBindings[p.first] = bindno++;
+    c_samplerArraySizes[p.first] = p.second;
+  }
+  c_shadowSamplers = shadow_samplers;
 
   // Prepare sampler source code.
   std::string samplerCode;
-  for(const auto& p : c_samplerBindings)
-    samplerCode += "layout (binding = " + std::to_string(p.second) + ") uniform sampler2D " + p.first + ";\n";
+  for(const auto& p : c_samplerBindings){
+    unsigned int size = c_samplerArraySizes[p.first];
+    std::string type = "sampler2D";
+    if(c_samplerTypes[p.first] == ImageType::Array) type = "sampler2DArray";
+    if(c_samplerTypes[p.first] == ImageType::Cube) type = "samplerCube";
+    if(c_shadowSamplers.count(p.first)) type += "Shadow";
+    samplerCode += "layout (binding = " + std::to_string(p.second) + ") uniform " + type + " " + p.first +
+      (size ? "[" + std::to_string(size) + "]" : "") + ";\n";
+  }
+
+  // Prepare storage images, bound after samplers.
+  for(const ShaderData& S : getStages()){
+    for(const auto& p : S.storageImages){
+      if(c_storageImages.count(p.name) || c_samplerBindings.count(p.name))
+        ProgramConfigError("StorageImageConflict", "Storage image \"" + p.name + "\" is declared more than once.").raise();
+      c_storageImages[p.name] = StorageImageData{bindno++, p.channels, p.format};
+    }
+  }
+  if(c_storageImages.size() > global::deviceLimits.maxPerStageDescriptorStorageImages)
+    ProgramConfigError("TooManyStorageImages", "This program uses " + std::to_string(c_storageImages.size()) + " storage images, but the device supports at most " + std::to_string(global::deviceLimits.maxPerStageDescriptorStorageImages) + " per shader.").raise();
+  // Storage images are always writable.
+  c_writesStorage = !c_storageImages.empty();
+  for(const auto& p : c_storageImages){
+    std::string prefix = getImageTypePrefix(getFormatProperties(p.second.channels, p.second.format).shaderDataType);
+    samplerCode += "layout (binding = " + std::to_string(p.second.bindno) + ", " +
+      getStorageFormatQualifier(p.second.channels, p.second.format) + ") uniform " + prefix + "image2D " + p.first + ";\n";
+  }
+
+  // Prepare storage buffers, bound after storage images.
+  std::map<std::string, StorageBufferParams> storage_buffers;
+  for(const ShaderData& S : getStages()){
+    for(const auto& p : S.storageBuffers){
+      auto it = storage_buffers.find(p.name);
+      if(it == storage_buffers.end()){
+        if(c_samplerBindings.count(p.name) || c_storageImages.count(p.name))
+          ProgramConfigError("StorageBufferConflict", "Storage buffer \"" + p.name + "\" has the same name as a sampler or a storage image.").raise();
+        storage_buffers[p.name] = p;
+      }else if(it->second.fields != p.fields || it->second.readOnly != p.readOnly){
+        ProgramConfigError("StorageBufferMismatch", "Storage buffer \"" + p.name + "\" is declared with different fields or access in vertex and fragment shaders.").raise();
+      }
+    }
+  }
+  if(storage_buffers.size() > global::deviceLimits.maxPerStageDescriptorStorageBuffers)
+    ProgramConfigError("TooManyStorageBuffers", "This program uses " + std::to_string(storage_buffers.size()) + " storage buffers, but the device supports at most " + std::to_string(global::deviceLimits.maxPerStageDescriptorStorageBuffers) + " per shader.").raise();
+  // Buffers can only be written by stages for which the device supports it.
+  std::string writableBufferCode, readonlyBufferCode;
+  bool anyBufferWritable = false;
+  for(const auto& p : storage_buffers){
+    const auto& fields = p.second.fields;
+    DataLayout layout;
+    for(const auto& f : fields) layout.extend(f.first);
+    c_storageBuffers[p.first] = StorageBufferData{bindno, layout};
+
+    std::string elementType;
+    std::string code;
+    if(fields.size() == 1 && fields[0].second == ""){
+      elementType = getDataTypeGLSLName(fields[0].first);
+    }else{
+      elementType = "sga_" + p.first + "_t";
+      code += "struct " + elementType + " {\n";
+      for(const auto& f : fields)
+        code += "  " + getDataTypeGLSLName(f.first) + " " + f.second + ";\n";
+      code += "};\n";
+    }
+    std::string block = "buffer sga_" + p.first + " {\n  " + elementType + " " + p.first + "[];\n};\n";
+    std::string binding = "layout(std430, binding = " + std::to_string(bindno++) + ") ";
+    writableBufferCode += code + binding + (p.second.readOnly ? "readonly " : "") + block;
+    readonlyBufferCode += code + binding + "readonly " + block;
+    anyBufferWritable = anyBufferWritable || !p.second.readOnly;
+  }
+
+  // Prepare input attachments, bound after storage buffers. Their indices
+  // follow declaration order, which is also the order of input attachments of
+  // the subpass a pipeline draws in.
+  std::string inputAttachmentCode;
+  for(unsigned int i = 0; i < FS.inputAttachments.size(); i++){
+    const auto& p = FS.inputAttachments[i];
+    if(c_samplerBindings.count(p.name) || c_storageImages.count(p.name) ||
+       c_storageBuffers.count(p.name) || c_inputAttachments.count(p.name))
+      ProgramConfigError("InputAttachmentConflict", "Input attachment \"" + p.name + "\" has the same name as another sampler, buffer or attachment.").raise();
+    c_inputAttachments[p.name] = InputAttachmentData{bindno, i, p.format};
+    std::string prefix = getImageTypePrefix(getFormatProperties(1, p.format).shaderDataType);
+    inputAttachmentCode += "layout (input_attachment_index = " + std::to_string(i) + ", binding = " +
+      std::to_string(bindno++) + ") uniform " + prefix + "subpassInput " + p.name + ";\n";
+  }
+  if(c_inputAttachments.size() > global::deviceLimits.maxPerStageDescriptorInputAttachments)
+    ProgramConfigError("TooManyInputAttachments", "This program uses " + std::to_string(c_inputAttachments.size()) + " input attachments, but the device supports at most " + std::to_string(global::deviceLimits.maxPerStageDescriptorInputAttachments) + " per shader.").raise();
   
   // Prepare attributes and their source code.
-  for(ShaderData& S : {std::ref(FS), std::ref(VS)}){
+  for(ShaderData& S : getStages()){
     for(unsigned int i = 0; i < S.inputAttr.size(); i++){
       S.attrCode += "layout(location = " + std::to_string(i) + ") in " +
         getDataTypeGLSLName(S.inputAttr[i].type) + " " + S.inputAttr[i].name + ";\n";
@@ -247,14 +497,24 @@ void Program::Impl::compile_internal() {
     #define sgaWindowCoords (gl_FragCoord.xy/sgaResolution)
     #define sgaViewportCoords ((gl_FragCoord.xy - sgaViewport.xy)/sgaViewport.zw)
   )";
+  if(isCompute)
+    extraCode = "layout(local_size_x = " + std::to_string(workGroupSize[0]) +
+      ", local_size_y = " + std::to_string(workGroupSize[1]) +
+      ", local_size_z = " + std::to_string(workGroupSize[2]) + ") in;\n";
 
   // Verify attributes inferface.
   if(VS.outputLayout != FS.inputLayout)
     ProgramConfigError("ShaderInterfaceMismatch", "Vertex shader output does not match fragment shader input.");
   
   // Emit full sources.
-  for(ShaderData& S : {std::ref(FS), std::ref(VS)}){
-    S.autoSource = preamble + S.attrCode + uniformCode + samplerCode + extraCode;
+  for(ShaderData& S : getStages()){
+    bool buffersWritable = (&S == &CS) ||
+      (&S == &VS && global::deviceFeatures.vertexPipelineStoresAndAtomics) ||
+      (&S == &FS && global::deviceFeatures.fragmentStoresAndAtomics);
+    std::string bufferCode = buffersWritable ? writableBufferCode : readonlyBufferCode;
+    if(buffersWritable && anyBufferWritable) c_writesStorage = true;
+    std::string attachmentCode = (&S == &FS) ? inputAttachmentCode : "";
+    S.autoSource = preamble + ((&S == &VS) ? vertexPreamble : "") + S.attrCode + uniformCode + samplerCode + bufferCode + attachmentCode + extraCode;
     S.fullSource = S.autoSource + S.source;
     //out_dbg("=== FULL SHADER SOURCE ===\n" + S.fullSource);
   }
@@ -264,6 +524,20 @@ void Program::Impl::compile_internal() {
   c_outputLayout = FS.outputLayout;
 
   // Compile to SPIRV.
+  if(isCompute){
+    try{
+      c_CS_shader = global::device->createShaderModule(
+        compileGLSLToSPIRV(vk::ShaderStageFlagBits::eCompute, CS.fullSource)
+        );
+    }catch(ShaderParsingError spe){
+      ShaderParsingError("ShaderParsingError", "While parsing compute shader:\n" + prepareErrorDescrip(spe.desc, CS)).raise();
+    }catch(ShaderLinkingError sle){
+      ShaderLinkingError("ShaderLinkingError", "While linking compute shader:\n" + prepareErrorDescrip(sle.desc, CS)).raise();
+    }
+    prepareLayouts();
+    compiled = true;
+    return;
+  }
   try{
     c_VS_shader = global::device->createShaderModule(
       compileGLSLToSPIRV(vk::ShaderStageFlagBits::eVertex, VS.fullSource)
@@ -282,10 +556,58 @@ void Program::Impl::compile_internal() {
   }catch(ShaderLinkingError sle){
     ShaderLinkingError("ShaderLinkingError", "While linking fragment shader:\n" + prepareErrorDescrip(sle.desc, FS)).raise();
   }
+
+  prepareLayouts();
   
   compiled = true;
 }
 
+void Program::Impl::prepareLayouts(){
+  if(isCompute)
+    c_stages = vk::ShaderStageFlagBits::eCompute;
+  else
+    c_stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+  // Descriptor bindings
+  std::vector<vkhlf::DescriptorSetLayoutBinding> dslbs;
+  dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, c_stages, nullptr));
+  unsigned int samplerDescriptors = 0;
+  for(const auto& s : c_samplerBindings){
+    dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(s.second, vk::DescriptorType::eCombinedImageSampler, c_stages, nullptr));
+    unsigned int count = std::max(1u, c_samplerArraySizes[s.first]);
+    dslbs.back().descriptorCount = count;
+    samplerDescriptors += count;
+  }
+  for(const auto& s : c_storageImages)
+    dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(s.second.bindno, vk::DescriptorType::eStorageImage, c_stages, nullptr));
+  for(const auto& s : c_storageBuffers)
+    dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(s.second.bindno, vk::DescriptorType::eStorageBuffer, c_stages, nullptr));
+  // Input attachments may only be accessed by fragment shaders.
+  for(const auto& s : c_inputAttachments)
+    dslbs.push_back(vkhlf::DescriptorSetLayoutBinding(s.second.bindno, vk::DescriptorType::eInputAttachment, vk::ShaderStageFlagBits::eFragment, nullptr));
+  c_descriptorSetLayout = global::device->createDescriptorSetLayout(dslbs);
+
+  c_descriptorRequirements.clear();
+  c_descriptorRequirements[vk::DescriptorType::eUniformBuffer] = 1;
+  if(samplerDescriptors > 0)
+    c_descriptorRequirements[vk::DescriptorType::eCombinedImageSampler] = samplerDescriptors;
+  if(!c_storageImages.empty())
+    c_descriptorRequirements[vk::DescriptorType::eStorageImage] = c_storageImages.size();
+  if(!c_storageBuffers.empty())
+    c_descriptorRequirements[vk::DescriptorType::eStorageBuffer] = c_storageBuffers.size();
+  if(!c_inputAttachments.empty())
+    c_descriptorRequirements[vk::DescriptorType::eInputAttachment] = c_inputAttachments.size();
+
+  std::vector<std::shared_ptr<vkhlf::DescriptorSetLayout>> setLayouts = {
+    c_descriptorSetLayout, global::frameUniforms->getSetLayout()};
+  if(isCompute){
+    c_pipelineLayout = global::device->createPipelineLayout(setLayouts, nullptr);
+    return;
+  }
+  vk::PushConstantRange standardRange(c_stages, 0, sizeof(StandardConstants));
+  c_pipelineLayout = global::device->createPipelineLayout(setLayouts, standardRange);
+}
+
 /* This function converts glslang-returned error message into somewhing
  * hopefully more meaningful for the end user. */
 std::string Program::Impl::prepareErrorDescrip(std::string infoLog, const ShaderData& sd) const{
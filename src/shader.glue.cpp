@@ -30,8 +30,20 @@ void Shader::addOutput(std::initializer_list<std::pair<DataType, std::string>> l
 void Shader::addUniform(DataType type, std::string name) {
   impl->addUniform(type, name);
 }
-void Shader::addSampler(std::string name) {
-  impl->addSampler(name);
+void Shader::addSampler(std::string name, ImageType type) {
+  impl->addSampler(name, type);
+}
+void Shader::addSamplerArray(std::string name, unsigned int size) {
+  impl->addSamplerArray(name, size);
+}
+void Shader::addShadowSampler(std::string name, ImageType type) {
+  impl->addShadowSampler(name, type);
+}
+void Shader::addStorageBuffer(std::string name, std::initializer_list<std::pair<DataType, std::string>> fields, bool readOnly) {
+  impl->addStorageBuffer(name, fields, readOnly);
+}
+void Shader::addStorageBuffer(std::string name, DataType type, bool readOnly) {
+  impl->addStorageBuffer(name, {{type, ""}}, readOnly);
 }
 
 
@@ -57,8 +69,23 @@ void Program::setFragmentShader(FragmentShader fs) {
   impl->setFragmentShader(fs);
 }
 
+void Program::setComputeShader(ComputeShader cs) {
+  impl->setComputeShader(cs);
+}
+
 void VertexShader::setOutputInterpolationMode(std::string name, sga::OutputInterpolationMode mode){
   impl->setOutputInterpolationMode(name, mode);
 }
 
+void FragmentShader::addInputAttachment(std::string name, ImageFormat format){
+  impl->addInputAttachment(name, format);
+}
+
+void ComputeShader::setWorkGroupSize(unsigned int x, unsigned int y, unsigned int z){
+  impl->setWorkGroupSize(x, y, z);
+}
+void ComputeShader::addStorageImage(std::string name, unsigned int channels, ImageFormat format){
+  impl->addStorageImage(name, channels, format);
+}
+
 } // namespace sga
@@ -0,0 +1,83 @@
+#include "staging.hpp"
+
+#include <algorithm>
+
+#include "global.hpp"
+#include "utils.hpp"
+#include "scheduler.hpp"
+
+namespace sga{
+
+// The size of the ring when it is first created. It grows in powers of two
+// up to the size limit, larger transfers get dedicated buffers.
+static const vk::DeviceSize initialRingSize = 4 << 20;
+static const vk::DeviceSize maxRingSize = 64 << 20;
+
+// Buffer offsets of copies must be multiples of the texel size of the image
+// format, and of 4. This is a multiple of both for all formats.
+static const vk::DeviceSize regionAlignment = 16;
+
+StagingRing::StagingRing(){
+  frame = Scheduler::getSyncCount();
+  grow(initialRingSize);
+}
+
+StagingRing::~StagingRing(){
+}
+
+StagingRing::Region StagingRing::createBuffer(vk::DeviceSize size){
+  Region r;
+  r.buffer = global::device->createBuffer(
+    size,
+    vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+    vk::SharingMode::eExclusive,
+    nullptr,
+    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+    nullptr);
+  r.offset = 0;
+  // The memory stays mapped for as long as the buffer lives.
+  r.data = (uint8_t*)r.buffer->get<vkhlf::DeviceMemory>()->map(0, size);
+  return r;
+}
+
+void StagingRing::grow(vk::DeviceSize size){
+  vk::DeviceSize newCapacity = std::max(capacity, initialRingSize);
+  while(newCapacity < size) newCapacity *= 2;
+
+  out_dbg("Creating a staging ring of " + std::to_string(newCapacity) + " bytes.");
+  if(ring.buffer) Scheduler::appendChainedResource(ring.buffer);
+  ring = createBuffer(newCapacity);
+  capacity = newCapacity;
+  head = 0;
+}
+
+StagingRing::Region StagingRing::allocate(vk::DeviceSize size){
+  if(size > maxRingSize){
+    // Keeping such a large ring around would waste memory.
+    Region r = createBuffer(size);
+    Scheduler::appendChainedResource(r.buffer);
+    return r;
+  }
+  if(size > capacity) grow(size);
+
+  uint64_t current = Scheduler::getSyncCount();
+  if(current != frame){
+    // All commands that might have used previous regions have completed.
+    head = 0;
+    frame = current;
+  }
+  vk::DeviceSize offset = (head + regionAlignment - 1) / regionAlignment * regionAlignment;
+  if(offset + size > capacity){
+    Scheduler::sync();
+    offset = 0;
+    frame = Scheduler::getSyncCount();
+  }
+  head = offset + size;
+
+  Region r = ring;
+  r.offset = offset;
+  r.data = ring.data + offset;
+  return r;
+}
+
+} // namespace sga
@@ -0,0 +1,23 @@
+#include <sga/statistics.hpp>
+
+#include "global.hpp"
+#include "descriptors.hpp"
+
+namespace sga{
+
+Statistics getStatistics(){
+  Statistics s;
+  if(!global::initialized) return s;
+
+  const auto& da = global::descriptorAllocator;
+  // Make sure counters of a retired frame are not reported.
+  da->getFrame();
+  s.descriptorPools = da->getPoolsNo();
+  s.descriptorSetCapacity = da->getSetCapacity();
+  s.descriptorSetsInUse = da->getSetsInUse();
+  s.descriptorSetsPeak = da->getSetsPeak();
+  s.descriptorSetsAllocated = da->getSetsAllocatedTotal();
+  return s;
+}
+
+} // namespace sga
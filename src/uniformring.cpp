@@ -0,0 +1,70 @@
+#include "uniformring.hpp"
+
+#include <algorithm>
+
+#include "global.hpp"
+#include "utils.hpp"
+#include "scheduler.hpp"
+
+namespace sga{
+
+// The size of the ring when it is first used. It doubles whenever a frame
+// needs more space.
+static const vk::DeviceSize initialRingSize = 64 << 10;
+
+UniformRing::UniformRing(){
+  frame = Scheduler::getSyncCount();
+}
+
+UniformRing::~UniformRing(){
+}
+
+void UniformRing::release(){
+  if(--holds == 0) frame = Scheduler::getSyncCount();
+}
+
+void UniformRing::retireFrameIfNeeded(){
+  if(holds) return;
+  uint64_t current = Scheduler::getSyncCount();
+  if(current == frame) return;
+
+  // All commands that might have used previous slices have completed.
+  head = 0;
+  replaced.clear();
+  frame = current;
+}
+
+void UniformRing::grow(vk::DeviceSize size){
+  vk::DeviceSize newCapacity = std::max(capacity * 2, initialRingSize);
+  while(newCapacity < size) newCapacity *= 2;
+
+  out_dbg("Creating a uniform ring of " + std::to_string(newCapacity) + " bytes.");
+  if(buffer) replaced.push_back(buffer);
+  buffer = global::device->createBuffer(
+    newCapacity,
+    vk::BufferUsageFlagBits::eUniformBuffer,
+    vk::SharingMode::eExclusive,
+    nullptr,
+    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+    nullptr);
+  // The memory stays mapped for as long as the buffer lives.
+  data = (uint8_t*)buffer->get<vkhlf::DeviceMemory>()->map(0, newCapacity);
+  capacity = newCapacity;
+  head = 0;
+}
+
+UniformRing::Slice UniformRing::allocate(vk::DeviceSize size){
+  retireFrameIfNeeded();
+
+  vk::DeviceSize alignment = std::max<vk::DeviceSize>(global::deviceLimits.minUniformBufferOffsetAlignment, 1);
+  vk::DeviceSize offset = (head + alignment - 1) / alignment * alignment;
+  if(!buffer || offset + size > capacity){
+    grow(size);
+    offset = 0;
+  }
+  head = offset + size;
+
+  return Slice{buffer, offset, data + offset};
+}
+
+} // namespace sga
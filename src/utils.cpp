@@ -7,6 +7,8 @@
 #include <regex>
 #include <fstream>
 #include <sstream>
+#include <map>
+#include <cstring>
 
 #include <vulkan/vulkan.h>
 #include <vkhlf/vkhlf.h>
@@ -17,6 +19,10 @@
 #include "global.hpp"
 #include "utils.hpp"
 #include "scheduler.hpp"
+#include "descriptors.hpp"
+#include "frame.hpp"
+#include "uniformring.hpp"
+#include "staging.hpp"
 
 namespace sga{
 void info(){
@@ -204,7 +210,31 @@ void init(VerbosityLevel verbosity, ErrorStrategy strategy){
   // Pick a queue family.
   global::queueFamilyIndex = indices[0];
 
-  global::device = global::physicalDevice->createDevice(vkhlf::DeviceQueueCreateInfo(global::queueFamilyIndex, 1.0f), nullptr, enabledDeviceExtensions);
+  // Enable optional features that SGA can make use of, if available.
+  vk::PhysicalDeviceFeatures supportedFeatures = global::physicalDevice->getFeatures();
+  global::deviceFeatures = vk::PhysicalDeviceFeatures();
+  global::deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+  global::deviceFeatures.wideLines = supportedFeatures.wideLines;
+  global::deviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+  global::deviceFeatures.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
+  global::deviceFeatures.vertexPipelineStoresAndAtomics = supportedFeatures.vertexPipelineStoresAndAtomics;
+  global::deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+  global::deviceLimits = global::physicalDevice->getProperties().limits;
+  vk::PhysicalDeviceMemoryProperties memProperties = global::physicalDevice->getMemoryProperties();
+  global::lazilyAllocatedMemory = false;
+  for(unsigned int i = 0; i < memProperties.memoryTypeCount; i++)
+    if(memProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated)
+      global::lazilyAllocatedMemory = true;
+
+  // Layered rendering from vertex shaders is an optional extension.
+  global::vertexShaderLayer = false;
+  for(const auto& e : global::physicalDevice->getExtensionProperties(""))
+    if(std::string(e.extensionName) == "VK_EXT_shader_viewport_index_layer")
+      global::vertexShaderLayer = true;
+  if(global::vertexShaderLayer)
+    enabledDeviceExtensions.push_back("VK_EXT_shader_viewport_index_layer");
+
+  global::device = global::physicalDevice->createDevice(vkhlf::DeviceQueueCreateInfo(global::queueFamilyIndex, 1.0f), nullptr, enabledDeviceExtensions, nullptr, global::deviceFeatures);
   out_dbg("Logical device created.");
 
   Scheduler::initQueue(global::queueFamilyIndex);
@@ -214,6 +244,12 @@ void init(VerbosityLevel verbosity, ErrorStrategy strategy){
   // m_deviceMemoryAllocatorImage.reset(new vkhlf::DeviceMemoryAllocator(getDevice(), 128 * 1024, nullptr));
 
   global::commandPool = global::device->createCommandPool(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, global::queueFamilyIndex);
+
+  global::descriptorAllocator = std::make_shared<DescriptorAllocator>(true);
+  global::stagingRing = std::make_shared<StagingRing>();
+  global::frameUniforms = std::make_shared<FrameUniformBlock>();
+  global::uniformRing = std::make_shared<UniformRing>();
+  global::pipelineCache = global::device->createPipelineCache(0, nullptr);
   
   global::initialized = true;
   out_msg("SGA initialized successfully.");
@@ -223,6 +259,11 @@ void init(VerbosityLevel verbosity, ErrorStrategy strategy){
 void terminate(){
   if(!global::initialized)
     return;
+  global::frameUniforms = nullptr;
+  global::uniformRing = nullptr;
+  global::descriptorAllocator = nullptr;
+  global::stagingRing = nullptr;
+  global::pipelineCache = nullptr;
   global::physicalDevice = nullptr;
   global::device = nullptr;
   Scheduler::releaseQueue();
@@ -335,6 +376,107 @@ vk::ClearColorValue Utils::imageClearColorToVkClearColorValue(ImageClearColor cc
   }
 }
 
+vk::SampleCountFlagBits Utils::getSampleCountFlag(unsigned int samples){
+  static const std::map<unsigned int, vk::SampleCountFlagBits> flags = {
+    {1,  vk::SampleCountFlagBits::e1},
+    {2,  vk::SampleCountFlagBits::e2},
+    {4,  vk::SampleCountFlagBits::e4},
+    {8,  vk::SampleCountFlagBits::e8},
+    {16, vk::SampleCountFlagBits::e16},
+    {32, vk::SampleCountFlagBits::e32},
+    {64, vk::SampleCountFlagBits::e64},
+  };
+  auto it = flags.find(samples);
+  if(it == flags.end()){
+    PipelineConfigError("InvalidSampleCount", "The number of samples per pixel must be a power of 2 no greater than 64, got " + std::to_string(samples) + ".").raise();
+    return vk::SampleCountFlagBits::e1;
+  }
+  vk::SampleCountFlags supported =
+    global::deviceLimits.framebufferColorSampleCounts & global::deviceLimits.framebufferDepthSampleCounts;
+  if(!(supported & it->second)){
+    PipelineConfigError("UnsupportedSampleCount", "This device does not support rendering with " + std::to_string(samples) + " samples per pixel.").raise();
+    return vk::SampleCountFlagBits::e1;
+  }
+  return it->second;
+}
+
+vk::ClearDepthStencilValue Utils::imageClearColorToVkClearDepthStencilValue(ImageClearColor cc){
+  return vk::ClearDepthStencilValue(cc.float32[0], 0);
+}
+
+vk::Format Utils::getDepthFormat(DepthFormat df){
+  vk::Format f;
+  switch(df){
+  case DepthFormat::D16:   f = vk::Format::eD16Unorm;         break;
+  case DepthFormat::D24S8: f = vk::Format::eD24UnormS8Uint;   break;
+  case DepthFormat::D32:
+  default:                 f = vk::Format::eD32Sfloat;        break;
+  }
+  ensureDepthFormatSupport(f);
+  return f;
+}
+
+void Utils::ensureDepthFormatSupport(vk::Format f){
+  vk::FormatProperties props = global::physicalDevice->getFormatProperties(f);
+  if(!(props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment))
+    ImageFormatError("DepthFormatUnsupported", "This device does not support the requested depth format.").raise();
+}
+
+vk::ImageAspectFlags Utils::getDepthAspect(vk::Format f){
+  if(f == vk::Format::eD24UnormS8Uint)
+    return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+  return vk::ImageAspectFlagBits::eDepth;
+}
+
+void Utils::recordUniformBufferUpdate(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer,
+                                      std::shared_ptr<vkhlf::Buffer> buffer,
+                                      size_t offset, size_t size, const char* data){
+  auto shaderStages = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader |
+                      vk::PipelineStageFlagBits::eComputeShader;
+  cmdBuffer->pipelineBarrier(shaderStages, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, nullptr);
+
+  // Small updates are stored inline in the command buffer. Offset and size
+  // are multiples of 4 for all uniform layouts.
+  if(size <= 65536){
+    cmdBuffer->updateBuffer(buffer, offset, vk::ArrayProxy<const uint32_t>(size / 4, (const uint32_t*)data));
+  }else{
+    std::shared_ptr<vkhlf::Buffer> staging = global::device->createBuffer(
+      size,
+      vk::BufferUsageFlagBits::eTransferSrc,
+      vk::SharingMode::eExclusive,
+      nullptr,
+      vk::MemoryPropertyFlagBits::eHostVisible,
+      nullptr);
+    auto sbdm = staging->get<vkhlf::DeviceMemory>();
+    void* pMapped = sbdm->map(0, size);
+    memcpy(pMapped, data, size);
+    sbdm->flush(0, size); sbdm->unmap();
+    Scheduler::appendChainedResource(staging);
+    cmdBuffer->copyBuffer(staging, buffer, vk::BufferCopy(0, offset, size));
+  }
+
+  cmdBuffer->pipelineBarrier(
+    vk::PipelineStageFlagBits::eTransfer, shaderStages, {},
+    vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eUniformRead),
+    nullptr, nullptr);
+}
+
+// Whether storage may have been written by commands recorded after the last
+// storage barrier.
+static bool storageWritesPending = false;
+
+void Utils::recordShaderStorageBarrier(std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer, bool writes){
+  bool needed = writes || storageWritesPending;
+  storageWritesPending = writes;
+  if(!needed) return;
+  auto shaderStages = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader |
+                      vk::PipelineStageFlagBits::eComputeShader;
+  cmdBuffer->pipelineBarrier(
+    shaderStages, shaderStages, {},
+    vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite),
+    nullptr, nullptr);
+}
+
 std::string Utils::readEntireFile(std::string path){
   std::ifstream file(path);
   if(!file){
@@ -6,6 +6,7 @@
 #include "utils.hpp"
 #include "global.hpp"
 #include "scheduler.hpp"
+#include "layout.hpp"
 
 namespace sga{
 
@@ -108,4 +109,108 @@ void IBO::Impl::putData(uint8_t *pData, unsigned int elem_n){
 }
 
 
+StorageBuffer::Impl::Impl(DataLayout layout, unsigned int n)
+  : layout(layout), n(n){
+  if(layout.layout.empty())
+    DataFormatError("StorageBufferEmptyLayout", "The layout of a storage buffer must have at least one value.").raise();
+  stride = getDataLayoutStd430Offsets(layout, offsets);
+
+  buffer = global::device->createBuffer(
+    getByteSize(),
+    vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eStorageBuffer,
+    vk::SharingMode::eExclusive,
+    nullptr,
+    vk::MemoryPropertyFlagBits::eDeviceLocal,
+    nullptr);
+
+  // Shaders may read the buffer before it is written.
+  std::vector<uint8_t> zeros(layout.byteSize() * n, 0);
+  putData(zeros.data(), n, layout.byteSize());
+}
+
+void StorageBuffer::Impl::copy(std::shared_ptr<vkhlf::Buffer> from, std::shared_ptr<vkhlf::Buffer> to){
+  auto shaderStages = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader |
+                      vk::PipelineStageFlagBits::eComputeShader;
+  Scheduler::buildAndSubmitSynced("Copying storage buffer data", [&](auto cmdBuffer){
+      cmdBuffer->pipelineBarrier(
+        shaderStages, vk::PipelineStageFlagBits::eTransfer, {},
+        vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite),
+        nullptr, nullptr);
+      cmdBuffer->copyBuffer(from, to, vk::BufferCopy(0, 0, getByteSize()));
+      cmdBuffer->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer, shaderStages, {},
+        vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite),
+        nullptr, nullptr);
+    });
+}
+
+void StorageBuffer::Impl::putData(uint8_t *pData, size_t n_elem, size_t elem_size){
+  if(elem_size != layout.byteSize())
+    DataFormatError("StorageBufferDataFormatMismatch", "The size of data element used to write into a storage buffer does not match the element size of the buffer").raise();
+  if(n_elem != n)
+    SizeError("StorageBufferWriteSizeMismatch", "Storage buffer size does not match the number of elements written to it").raise();
+
+  std::shared_ptr<vkhlf::Buffer> stagingBuffer = global::device->createBuffer(
+    getByteSize(),
+    vk::BufferUsageFlagBits::eTransferSrc,
+    vk::SharingMode::eExclusive,
+    nullptr,
+    vk::MemoryPropertyFlagBits::eHostVisible,
+    nullptr);
+  auto devmem = stagingBuffer->get<vkhlf::DeviceMemory>();
+  uint8_t* pMapped = (uint8_t*)devmem->map(0, getByteSize());
+  if(stride == elem_size){
+    memcpy(pMapped, pData, getByteSize());
+  }else{
+    // Rearrange values into std430 layout.
+    memset(pMapped, 0, getByteSize());
+    for(unsigned int i = 0; i < n; i++){
+      uint8_t* src = pData + i * elem_size;
+      for(unsigned int j = 0; j < offsets.size(); j++){
+        size_t size = getDataTypeSize(layout.layout[j]);
+        memcpy(pMapped + i * stride + offsets[j], src, size);
+        src += size;
+      }
+    }
+  }
+  devmem->flush(0, getByteSize());
+  devmem->unmap();
+
+  copy(stagingBuffer, buffer);
+}
+
+void StorageBuffer::Impl::getData(uint8_t *pData, size_t n_elem, size_t elem_size){
+  if(elem_size != layout.byteSize())
+    DataFormatError("StorageBufferDataFormatMismatch", "The size of data element used to read from a storage buffer does not match the element size of the buffer").raise();
+  if(n_elem != n)
+    SizeError("StorageBufferReadSizeMismatch", "Storage buffer size does not match the number of elements read from it").raise();
+
+  std::shared_ptr<vkhlf::Buffer> stagingBuffer = global::device->createBuffer(
+    getByteSize(),
+    vk::BufferUsageFlagBits::eTransferDst,
+    vk::SharingMode::eExclusive,
+    nullptr,
+    vk::MemoryPropertyFlagBits::eHostVisible,
+    nullptr);
+
+  copy(buffer, stagingBuffer);
+
+  auto devmem = stagingBuffer->get<vkhlf::DeviceMemory>();
+  uint8_t* pMapped = (uint8_t*)devmem->map(0, getByteSize());
+  devmem->invalidate(0, getByteSize());
+  if(stride == elem_size){
+    memcpy(pData, pMapped, getByteSize());
+  }else{
+    for(unsigned int i = 0; i < n; i++){
+      uint8_t* dst = pData + i * elem_size;
+      for(unsigned int j = 0; j < offsets.size(); j++){
+        size_t size = getDataTypeSize(layout.layout[j]);
+        memcpy(dst, pMapped + i * stride + offsets[j], size);
+        dst += size;
+      }
+    }
+  }
+  devmem->unmap();
+}
+
 } // namespace sga
@@ -41,4 +41,28 @@ void IBO::putData(uint8_t* pData, unsigned int elem_n){
   impl->putData(pData, elem_n);
 }
 
+
+
+StorageBuffer::StorageBuffer(DataLayout layout, unsigned int n)
+  : impl(std::make_shared<StorageBuffer::Impl>(layout, n)){
+}
+
+StorageBuffer::~StorageBuffer() = default;
+
+DataLayout StorageBuffer::getLayout() const{
+  return impl->getLayout();
+}
+
+unsigned int StorageBuffer::getSize() const{
+  return impl->getSize();
+}
+
+void StorageBuffer::putData(uint8_t* pData, size_t n_elem, size_t elem_size){
+  impl->putData(pData, n_elem, elem_size);
+}
+
+void StorageBuffer::getData(uint8_t* pData, size_t n_elem, size_t elem_size){
+  impl->getData(pData, n_elem, elem_size);
+}
+
 } // namespace sga
@@ -58,6 +58,9 @@ unsigned int Window::getHeight() {return impl->getHeight();}
 void Window::setOnResize(std::function<void (unsigned int, unsigned int)> f) {impl->setOnResize(f);}
 
 void Window::setClearColor(ImageClearColor cc) {return impl->setClearColor(cc);}
+void Window::setMultisampling(unsigned int samples) {impl->setMultisampling(samples);}
+void Window::setDepthFormat(DepthFormat format) {impl->setDepthFormat(format);}
+void Window::setDepthClearValue(float value) {impl->setDepthClearValue(value);}
 
 // ====== IMPL ======
 
@@ -90,26 +93,7 @@ Window::Impl::Impl(unsigned int width, unsigned int height, std::string title) :
     
     // Create the renderpass used for drawing onto this window.
     // Note that it may be shared between multiple pipelines!
-    vk::AttachmentReference colorReference(0, vk::ImageLayout::eColorAttachmentOptimal);
-    vk::AttachmentReference depthReference(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);  
-    renderPass = global::device->createRenderPass(
-      { vk::AttachmentDescription( // attachment 0
-          {}, colorFormat, vk::SampleCountFlagBits::e1,
-          vk::AttachmentLoadOp::eLoad, vk::AttachmentStoreOp::eStore, // color
-          vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
-          vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR
-          ),
-        vk::AttachmentDescription( // attachment 1
-          {}, depthFormat, vk::SampleCountFlagBits::e1,
-          vk::AttachmentLoadOp::eLoad, vk::AttachmentStoreOp::eStore, // depth
-          vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
-          vk::ImageLayout::eUndefined,vk::ImageLayout::eDepthStencilAttachmentOptimal
-          )
-      },
-      vk::SubpassDescription( {}, vk::PipelineBindPoint::eGraphics, 0, nullptr, 1,
-                              &colorReference, nullptr,
-                              &depthReference, 0, nullptr),
-      nullptr );
+    createRenderPasses();
     
     // This will also create the initial swapchain.
     do_resize(width, height);
@@ -148,7 +132,164 @@ void Window::Impl::do_resize(unsigned int w, unsigned int h){
   if(f_onResize) f_onResize(width,height);
 }
 
+std::shared_ptr<vkhlf::RenderPass> Window::Impl::createRenderPass(vk::SampleCountFlagBits samples, bool clear){
+  bool multisampled = (samples != vk::SampleCountFlagBits::e1);
+  vk::AttachmentLoadOp loadOp = clear ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
+  vk::AttachmentReference colorReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+  vk::AttachmentReference depthReference(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+  vk::AttachmentReference resolveReference(2, vk::ImageLayout::eColorAttachmentOptimal);
+  std::vector<vk::AttachmentDescription> attachments;
+  if(!multisampled){
+    attachments = {
+      vk::AttachmentDescription( // attachment 0
+        {}, colorFormat, vk::SampleCountFlagBits::e1,
+        loadOp, vk::AttachmentStoreOp::eStore, // color
+        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
+        vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR
+        ),
+      vk::AttachmentDescription( // attachment 1
+        {}, depthFormat, vk::SampleCountFlagBits::e1,
+        loadOp, vk::AttachmentStoreOp::eStore, // depth
+        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
+        vk::ImageLayout::eUndefined,vk::ImageLayout::eDepthStencilAttachmentOptimal
+        )
+    };
+  }else{
+    // Multisampled images keep their contents between render passes, and
+    // are resolved onto the swapchain image at the end of each of them.
+    attachments = {
+      vk::AttachmentDescription( // attachment 0
+        {}, colorFormat, samples,
+        loadOp, vk::AttachmentStoreOp::eStore, // color
+        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
+        clear ? vk::ImageLayout::eUndefined : vk::ImageLayout::eColorAttachmentOptimal,
+        vk::ImageLayout::eColorAttachmentOptimal
+        ),
+      vk::AttachmentDescription( // attachment 1
+        {}, depthFormat, samples,
+        loadOp, vk::AttachmentStoreOp::eStore, // depth
+        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
+        clear ? vk::ImageLayout::eUndefined : vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        vk::ImageLayout::eDepthStencilAttachmentOptimal
+        ),
+      vk::AttachmentDescription( // attachment 2
+        {}, colorFormat, vk::SampleCountFlagBits::e1,
+        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eStore, // resolve
+        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, // stencil
+        vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR
+        )
+    };
+  }
+  return global::device->createRenderPass(
+    attachments,
+    vk::SubpassDescription( {}, vk::PipelineBindPoint::eGraphics, 0, nullptr, 1,
+                            &colorReference, multisampled ? &resolveReference : nullptr,
+                            &depthReference, 0, nullptr),
+    nullptr );
+}
+
+void Window::Impl::createRenderPasses(){
+  // A pending clear is performed by the render pass variant which clears
+  // attachments on load. Both variants are compatible, so pipelines and
+  // framebuffers created for one can be used with the other.
+  renderPass = createRenderPass(samples, false);
+  renderPassClear = createRenderPass(samples, true);
+  // Swapchain framebuffers are always single-sampled.
+  if(samples == vk::SampleCountFlagBits::e1)
+    swapchainRenderPass = renderPass;
+  else
+    swapchainRenderPass = createRenderPass(vk::SampleCountFlagBits::e1, false);
+}
+
+void Window::Impl::setMultisampling(unsigned int s){
+  vk::SampleCountFlagBits flag = Utils::getSampleCountFlag(s);
+  if(flag == samples) return;
+  // Previously recorded draws may still use the old images.
+  Scheduler::sync();
+  samples = flag;
+  // Pipelines notice that the render pass has changed and rebuild themselves.
+  createRenderPasses();
+  createMultisampleTargets();
+  clearCurrentFrame();
+}
+
+void Window::Impl::setDepthFormat(DepthFormat format){
+  vk::Format f = Utils::getDepthFormat(format);
+  if(f == depthFormat) return;
+  // Previously recorded draws may still use the old depth buffers.
+  Scheduler::sync();
+  depthFormat = f;
+  // Pipelines notice that the render pass has changed and rebuild themselves.
+  createRenderPasses();
+  createSwapchainsAndFramebuffer();
+  frameno = 0;
+  clearCurrentFrame();
+}
+
+void Window::Impl::setDepthClearValue(float value){
+  depthClearValue = value;
+}
+
+void Window::Impl::createMultisampleTargets(){
+  msFramebuffers.clear();
+  msColorImage = nullptr;
+  msDepthImage = nullptr;
+  if(samples == vk::SampleCountFlagBits::e1 || !framebufferSwapchain) return;
+
+  vk::Extent2D extent = framebufferSwapchain->getExtent();
+  msColorImage = global::device->createImage(
+    vk::ImageCreateFlags(), vk::ImageType::e2D, colorFormat,
+    vk::Extent3D(extent.width, extent.height, 1), 1, 1, samples,
+    vk::ImageTiling::eOptimal,
+    vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst,
+    vk::SharingMode::eExclusive, std::vector<uint32_t>(),
+    vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal,
+    nullptr, nullptr);
+  msDepthImage = global::device->createImage(
+    vk::ImageCreateFlags(), vk::ImageType::e2D, depthFormat,
+    vk::Extent3D(extent.width, extent.height, 1), 1, 1, samples,
+    vk::ImageTiling::eOptimal,
+    vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferDst,
+    vk::SharingMode::eExclusive, std::vector<uint32_t>(),
+    vk::ImageLayout::eUndefined, vk::MemoryPropertyFlagBits::eDeviceLocal,
+    nullptr, nullptr);
+  msColorView = msColorImage->createImageView(
+    vk::ImageViewType::e2D, colorFormat,
+    { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
+    { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+  msDepthView = msDepthImage->createImageView(
+    vk::ImageViewType::e2D, depthFormat,
+    { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
+    { Utils::getDepthAspect(depthFormat), 0, 1, 0, 1 });
+  // The new images have no contents and an undefined layout, which only the
+  // render pass variant clearing them on load accepts.
+  pendingClear = true;
+}
+
+std::pair<std::shared_ptr<vkhlf::Framebuffer>, vk::Extent2D> Window::Impl::getCurrentFramebuffer(){
+  vk::Extent2D extent = framebufferSwapchain->getExtent();
+  if(samples == vk::SampleCountFlagBits::e1)
+    return std::make_pair(framebufferSwapchain->getFramebuffer(), extent);
+
+  // Multisampled framebuffers resolve onto the current swapchain image, one
+  // is created for each of them.
+  auto image = framebufferSwapchain->getColorImage();
+  auto it = msFramebuffers.find(image.get());
+  if(it != msFramebuffers.end())
+    return std::make_pair(it->second, extent);
+  auto resolveView = image->createImageView(
+    vk::ImageViewType::e2D, colorFormat,
+    { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
+    { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+  auto framebuffer = global::device->createFramebuffer(
+    renderPass, std::vector<std::shared_ptr<vkhlf::ImageView>>{msColorView, msDepthView, resolveView}, extent, 1);
+  msFramebuffers[image.get()] = framebuffer;
+  return std::make_pair(framebuffer, extent);
+}
+
 void Window::Impl::createSwapchainsAndFramebuffer(){
+  // Framebuffers resolving onto old swapchain images must go first.
+  msFramebuffers.clear();
   // Before creating the new framebuffer stapchain, the old one must be destroyed.
   framebufferSwapchain.reset();
   
@@ -158,13 +299,15 @@ void Window::Impl::createSwapchainsAndFramebuffer(){
       surface,
       colorFormat, 
       depthFormat,
-      renderPass,
+      swapchainRenderPass,
       // TODO: TransferDst is not guaranteed to be supported!
       // See: https://www.khronos.org/registry/vulkan/specs/1.0-wsi_extensions/html/vkspec.html#_surface_queries
       vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst,
       std::vector<vk::PresentModeKHR>{vk::PresentModeKHR::eImmediate}
       )
     );
+
+  createMultisampleTargets();
 }
 
 void Window::Impl::nextFrame() {
@@ -191,8 +334,10 @@ void Window::Impl::nextFrame() {
     if(frameno > 0){
       if(!currentFrameRendered){
         std::cout << "SGA WARNING: Nothing was rendered onto current frame, skipping it." << std::endl;
-        clearCurrentFrame(vk::ClearColorValue(std::array<float,4>({1.0f, 0.0f, 1.0f, 1.0f})));
+        clearCurrentFrameNow(vk::ClearColorValue(std::array<float,4>({1.0f, 0.0f, 1.0f, 1.0f})));
       }
+      // The frame was cleared, but nothing was drawn onto it afterwards.
+      flushClear();
       
       Scheduler::presentSynced(framebufferSwapchain);
     }
@@ -240,34 +385,57 @@ void Window::Impl::setClearColor(ImageClearColor cc){
 }
 
 void Window::Impl::clearCurrentFrame(){
-  clearCurrentFrame(Utils::imageClearColorToVkClearColorValue(clearColor));
+  pendingClear = true;
+}
+
+void Window::Impl::flushClear(){
+  if(!pendingClear) return;
+  clearCurrentFrameNow(Utils::imageClearColorToVkClearColorValue(clearColor));
+}
+
+std::vector<vk::ClearValue> Window::Impl::getClearValues(){
+  return {vk::ClearValue(Utils::imageClearColorToVkClearColorValue(clearColor)),
+          vk::ClearValue(vk::ClearDepthStencilValue(depthClearValue, 0))};
 }
 
-void Window::Impl::clearCurrentFrame(vk::ClearColorValue cc){
+void Window::Impl::clearCurrentFrameNow(vk::ClearColorValue cc){
+  pendingClear = false;
   if(!framebufferSwapchain)
     return;
   Scheduler::buildAndSubmitSynced("Clearing frame", [&](std::shared_ptr<vkhlf::CommandBuffer> cmdBuffer){
+      auto clearColorImage = [&](std::shared_ptr<vkhlf::Image> image){
+        vkhlf::setImageLayout(
+          cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
+          vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+        
+        cmdBuffer->clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue(cc));
+        
+        vkhlf::setImageLayout(
+          cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
+          vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eColorAttachmentOptimal);
+      };
+      vk::ImageAspectFlags depthAspect = Utils::getDepthAspect(depthFormat);
+      auto clearDepthImage = [&](std::shared_ptr<vkhlf::Image> image){
+        vkhlf::setImageLayout(
+          cmdBuffer, image, depthAspect,
+          vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+        cmdBuffer->clearDepthStencilImage(image, vk::ImageLayout::eTransferDstOptimal, depthClearValue, 0, vk::ImageSubresourceRange(depthAspect, 0, 1, 0, 1));
+        vkhlf::setImageLayout(
+          cmdBuffer, image, depthAspect,
+          vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+      };
+
       // Clear the new frame.
-      auto image = framebufferSwapchain->getColorImage();
-      vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
-        vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-      
-      cmdBuffer->clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue(cc));
-      
-      vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eColor,
-        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eColorAttachmentOptimal);
-
-      // Clear the depth buffer.
-      image = framebufferSwapchain->getDepthImage();
-      vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eDepth,
-        vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-      cmdBuffer->clearDepthStencilImage(image, vk::ImageLayout::eTransferDstOptimal, 1.0f, 0, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1));
-      vkhlf::setImageLayout(
-        cmdBuffer, image, vk::ImageAspectFlagBits::eDepth,
-        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+      clearColorImage(framebufferSwapchain->getColorImage());
+
+      // Clear the depth buffer. When multisampling, the swapchain image only
+      // receives resolved results, so the multisampled images are cleared too.
+      if(msColorImage){
+        clearColorImage(msColorImage);
+        clearDepthImage(msDepthImage);
+      }else{
+        clearDepthImage(framebufferSwapchain->getDepthImage());
+      }
     });
 }
 